@@ -13,18 +13,26 @@
 #include <lua.hpp>
 
 
+#include "detail/LuaArrayView.hh"
+#include "detail/LuaBind.hh"
+#include "detail/LuaBytecodeCache.hh"
 #include "detail/LuaCallable.hh"
 #include "detail/LuaCallable_CppFunction.hh"
 #include "detail/LuaCallable_MemberFunction.hh"
 #include "detail/LuaCallFromStack.hh"
+#include "detail/LuaChunk.hh"
+#include "detail/LuaChunkReader.hh"
 #include "detail/LuaCoroutine.hh"
 #include "detail/LuaDelayedPop.hh"
 #include "detail/LuaExceptions.hh"
+#include "detail/LuaFunctionWrapper.hh"
+#include "detail/LuaIdentityCache.hh"
 #include "detail/LuaMakeClass.hh"
 #include "detail/LuaObject.hh"
 #include "detail/LuaPush.hh"
 #include "detail/LuaRead.hh"
 #include "detail/LuaTableReference.hh"
+#include "detail/LuaTableView.hh"
 #include "detail/TemplateUtils.hh"
 
 namespace Lua{
@@ -67,12 +75,45 @@ namespace Lua{
     //! Returns the current memory limit.
     unsigned long GetMaxMemory(){ return memory[1]; }
 
+    //! Reuse the userdata when the same object is pushed more than once.
+    /*! Applies to objects pushed as std::shared_ptr or as C-style pointers.
+      Pushing the same object again, as the same type, returns the existing userdata,
+        rather than allocating a new one.
+      This avoids churning the garbage collector when objects are repeatedly passed to Lua,
+        and lets scripts compare objects or use them as table keys.
+      The cache does not keep objects alive.
+
+      References passed as std::ref/std::cref are never cached,
+        since they are only valid for the duration of a single call.
+     */
+    void EnableIdentityCache(){ Lua::EnableIdentityCache(state()); }
+
+    //! Caches the compiled bytecode of files loaded with LoadFile.
+    /*! Files loaded afterwards are compiled once, and the bytecode is saved in cache_dir.
+      Later loads of the same file, with the same contents, load the bytecode instead,
+        skipping the parser.
+      This is most useful when many LuaStates load the same scripts.
+
+      Since Lua does not verify bytecode, loading untrusted bytecode is unsafe.
+      Bytecode is only loaded if cache_dir and the cached file are owned by the effective user,
+        and are not writable by the group or other users.
+      cache_dir should not be inside a directory that other users can write to.
+
+      Returns false, and disables the cache, if cache_dir cannot be created or is not trusted.
+    */
+    bool SetBytecodeCache(const std::string& cache_dir);
+
     //! Load a file into Lua
     /*! Loads a file, then executes.
+      If a bytecode cache has been set, it is used.
     */
     template<typename RetVal=void, typename... Params>
     RetVal LoadFile(const char* filename, Params&&... params){
-      PushCodeFile(state(), filename);
+      if(bytecode_cache_dir.empty()){
+        PushCodeFile(state(), filename);
+      } else {
+        PushCodeFileCached(state(), filename, bytecode_cache_dir);
+      }
       return CallFromStack<RetVal>(std::forward<Params>(params)...);
     }
 
@@ -85,6 +126,48 @@ namespace Lua{
       return CallFromStack<RetVal>(std::forward<Params>(params)...);
     }
 
+    //! Load a buffer of Lua code into Lua
+    /*! Loads the code, then executes.
+      Unlike LoadString, the length is given explicitly,
+        so the code may contain embedded null characters,
+        and need not be null-terminated.
+      The chunkname is used in error messages, such as "=generated".
+    */
+    template<typename RetVal=void, typename... Params>
+    RetVal LoadBuffer(const char* buffer, size_t size, const char* chunkname, Params&&... params){
+      PushCodeBuffer(state(), buffer, size, chunkname);
+      return CallFromStack<RetVal>(std::forward<Params>(params)...);
+    }
+
+    //! Load Lua code from a ChunkReader into Lua
+    /*! Loads the code, then executes.
+      The code is given to Lua in blocks, as returned by the reader,
+        without first being collected into a single string.
+      Use MappedFileReader to load a file without copying it,
+        or StreamReader to load from a std::istream.
+
+      Usage:
+        Lua::MappedFileReader reader("data.lua");
+        L.LoadStream(reader, "@data.lua");
+    */
+    template<typename RetVal=void, typename... Params>
+    RetVal LoadStream(ChunkReader& reader, const char* chunkname, Params&&... params){
+      PushCodeStream(state(), reader, chunkname);
+      return CallFromStack<RetVal>(std::forward<Params>(params)...);
+    }
+
+    //! Compiles Lua code, without running it.
+    /*! Returns a Chunk, which can be run repeatedly without parsing the code again.
+      The chunkname is used in error messages, such as "=rule".
+
+      @throws LuaFileParseError The code could not be parsed.
+    */
+    Chunk Compile(const std::string& lua_code, const char* chunkname){
+      PushCodeBuffer(state(), lua_code.data(), lua_code.size(), chunkname);
+      LuaDelayedPop delayed(state(), 1);
+      return Chunk(shared_L, -1);
+    }
+
     //! Load all standard Lua libraries.
     /*! Loads all standard Lua libraries
       TODO: Provide more granular control, for creation of sandboxes.
@@ -145,6 +228,34 @@ namespace Lua{
       return CallFromStack<RetVal>(std::forward<Params>(params)...);
     }
 
+    //! Returns a handle to a global Lua function.
+    /*! The function is looked up once, then held in the registry.
+      Calling the handle skips the lookup by name,
+        and continues to call the same function if the global is later reassigned.
+
+      Usage:
+        auto add = L.GetFunction<int(int, int)>("add");
+        int sum = add(1, 2);
+
+      @throws LuaInvalidStackContents The global variable is not a function,
+          nor a value with a __call metamethod.
+    */
+    template<typename FuncType>
+    LuaFunction<FuncType> GetFunction(const char* name){
+      lua_getglobal(state(), name);
+      LuaDelayedPop delayed(state(), 1);
+      if(lua_isnil(state(), -1)){
+        throw LuaInvalidStackContents("Global function was not defined");
+      }
+      if(!lua_isfunction(state(), -1)){
+        if(luaL_getmetafield(state(), -1, "__call") == LUA_TNIL){
+          throw LuaInvalidStackContents("Global variable was not callable");
+        }
+        lua_pop(state(), 1);
+      }
+      return LuaFunction<FuncType>(shared_L, -1);
+    }
+
     //! Creates and returns a new table
     /*! Another of those functions that would be best avoided.
       It places a table on the stack, which the user must later remove.
@@ -238,6 +349,9 @@ namespace Lua{
 
     //! The internal lua state.
     std::shared_ptr<lua_State> shared_L;
+
+    //! The directory used by LoadFile to cache bytecode, or empty if not caching.
+    std::string bytecode_cache_dir;
   };
 }
 
@@ -0,0 +1,57 @@
+#ifndef _LUAARRAYKERNELS_H_
+#define _LUAARRAYKERNELS_H_
+
+#include <cstddef>
+#include <type_traits>
+
+namespace Lua{
+  //! The type used to return sums and dot products of an array of T.
+  /*! Floating point arrays are summed as at least a double.
+    Integer arrays are summed as a long long, wrapping around on overflow as Lua integers do.
+   */
+  template<typename T>
+  using array_accumulator = typename std::conditional<
+    std::is_floating_point<T>::value,
+    typename std::common_type<T, double>::type,
+    long long>::type;
+
+  //! Bulk operations on contiguous arrays, used by the methods of ArrayView.
+  /*! These are defined in LuaArrayKernels.cc, and instantiated for every numeric type.
+    The loops are written to be vectorized by the compiler.
+    Where supported, each is also compiled for AVX2,
+      with the version used selected at load time based on the CPU.
+
+    Integer arithmetic wraps around on overflow.
+   */
+  template<typename T>
+  struct ArrayKernels{
+    //! data[i] *= factor
+    static void scale(T* data, size_t size, T factor);
+
+    //! data[i] += value
+    static void add(T* data, size_t size, T value);
+
+    //! data[i] += other[i]
+    static void add(T* data, size_t size, const T* other);
+
+    //! data[i] += factor*other[i]
+    static void fma(T* data, size_t size, const T* other, T factor);
+
+    //! data[i] = min(max(data[i], low), high)
+    static void clamp(T* data, size_t size, T low, T high);
+
+    //! Returns the sum of all elements.
+    static array_accumulator<T> sum(const T* data, size_t size);
+
+    //! Returns the sum of data[i]*other[i].
+    static array_accumulator<T> dot(const T* data, size_t size, const T* other);
+
+    //! Returns the smallest element.  The array must not be empty.
+    static T min(const T* data, size_t size);
+
+    //! Returns the largest element.  The array must not be empty.
+    static T max(const T* data, size_t size);
+  };
+}
+
+#endif /* _LUAARRAYKERNELS_H_ */
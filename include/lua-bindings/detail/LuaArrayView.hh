@@ -0,0 +1,356 @@
+#ifndef _LUAARRAYVIEW_H_
+#define _LUAARRAYVIEW_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <lua.hpp>
+
+#include "LuaArrayKernels.hh"
+#include "LuaExceptions.hh"
+#include "LuaPush.hh"
+#include "LuaRead.hh"
+
+namespace Lua{
+  //! A contiguous array of numbers, exposed to Lua without copying into a table.
+  /*! The array is either owned, held by a std::shared_ptr<std::vector<T> >,
+        or borrowed, pointing to memory owned elsewhere.
+      Copies of an ArrayView refer to the same elements.
+
+    In Lua, the array can be indexed from 1 to #array, and elements can be assigned.
+    Reading outside of the array returns nil, and writing outside of the array is an error.
+    The array cannot be resized from Lua.
+
+    When owned through a shared std::vector, the vector must not be resized while Lua holds the array.
+    When borrowed, the memory must outlive every use from Lua.
+   */
+  template<typename T>
+  class ArrayView{
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                  "ArrayView requires a numeric type");
+
+  public:
+    //! An empty array.
+    ArrayView() : ptr(nullptr), len(0) { }
+
+    //! Takes ownership of the vector.
+    ArrayView(std::vector<T> vec)
+      : ArrayView(std::make_shared<std::vector<T> >(std::move(vec))) { }
+
+    //! Shares ownership of the vector with C++.
+    ArrayView(std::shared_ptr<std::vector<T> > vec)
+      : owner(std::move(vec)), ptr(owner->data()), len(owner->size()) { }
+
+    //! Refers to memory owned elsewhere.
+    static ArrayView Borrow(T* data, size_t size){
+      ArrayView output;
+      output.ptr = data;
+      output.len = size;
+      return output;
+    }
+
+    T* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + len; }
+    T& operator[](size_t i) const { return ptr[i]; }
+
+  private:
+    std::shared_ptr<std::vector<T> > owner;
+    T* ptr;
+    size_t len;
+  };
+
+  //! Returns the registry key of the metatable for ArrayView<T>.
+  template<typename T>
+  struct array_view_registry_entry{
+    static void* get(){ return &id; }
+    static char id;
+  };
+
+  template<typename T>
+  char array_view_registry_entry<T>::id = 0;
+
+  //! The metamethods and methods of ArrayView<T>, as seen from Lua.
+  template<typename T>
+  struct ArrayViewMethods{
+    //! Returns the ArrayView at the given index, or nullptr if it is not an ArrayView<T>.
+    static ArrayView<T>* to_array(lua_State* L, int index){
+      void* storage = lua_touserdata(L, index);
+      if(!storage || !lua_getmetatable(L, index)){
+        return nullptr;
+      }
+      lua_rawgetp(L, LUA_REGISTRYINDEX, array_view_registry_entry<T>::get());
+      bool is_array = lua_rawequal(L, -1, -2);
+      lua_pop(L, 2);
+      return is_array ? static_cast<ArrayView<T>*>(storage) : nullptr;
+    }
+
+    //! Returns the ArrayView at the given index, raising a Lua error if it is not an ArrayView<T>.
+    static ArrayView<T>& check_array(lua_State* L, int index){
+      ArrayView<T>* output = to_array(L, index);
+      if(!output){
+        luaL_argerror(L, index, "expected array");
+      }
+      return *output;
+    }
+
+    //! Returns the zero-based position of a one-based Lua index, raising a Lua error if out of bounds.
+    static size_t check_index(lua_State* L, const ArrayView<T>& array, int arg){
+      lua_Integer i = luaL_checkinteger(L, arg);
+      if(i < 1 || static_cast<size_t>(i) > array.size()){
+        luaL_argerror(L, arg, "index out of range");
+      }
+      return i - 1;
+    }
+
+    //! Reads an element, raising a Lua error if it is not a number.
+    /*! As with Lua::Read, integers are read exactly, and other numbers are truncated.
+      Raises a Lua error rather than throwing, since this is only used from Lua.
+     */
+    static T check_element(lua_State* L, int arg){
+      int isnum;
+      if(std::is_integral<T>::value){
+        lua_Integer value = lua_tointegerx(L, arg, &isnum);
+        if(isnum){
+          return static_cast<T>(value);
+        }
+      }
+
+      lua_Number value = lua_tonumberx(L, arg, &isnum);
+      if(!isnum){
+        luaL_argerror(L, arg, "expected number");
+      }
+      return static_cast<T>(value);
+    }
+
+    static int garbage_collect(lua_State* L){
+      static_cast<ArrayView<T>*>(lua_touserdata(L, 1))->~ArrayView<T>();
+      return 0;
+    }
+
+    //! __index, with the table of methods as upvalue.
+    static int index(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+
+      int isnum;
+      lua_Integer i = lua_tointegerx(L, 2, &isnum);
+      if(isnum){
+        if(i >= 1 && static_cast<size_t>(i) <= array.size()){
+          Push<false>(L, array[i-1]);
+        } else {
+          lua_pushnil(L);
+        }
+      } else {
+        lua_pushvalue(L, 2);
+        lua_rawget(L, lua_upvalueindex(1));
+      }
+      return 1;
+    }
+
+    static int newindex(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      size_t i = check_index(L, array, 2);
+      array[i] = check_element(L, 3);
+      return 0;
+    }
+
+    static int length(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      lua_pushinteger(L, array.size());
+      return 1;
+    }
+
+    //! array:fill(value), sets every element to value.
+    static int fill(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      T value = check_element(L, 2);
+      std::fill(array.begin(), array.end(), value);
+      return 0;
+    }
+
+    //! array:totable(), copies the elements into a new table.
+    static int totable(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      lua_createtable(L, static_cast<int>(array.size()), 0);
+      for(size_t i=0; i<array.size(); i++){
+        Push<false>(L, array[i]);
+        lua_rawseti(L, -2, i+1);
+      }
+      return 1;
+    }
+
+    //! array:copy(), returns a new array, owned by Lua, with the same elements.
+    static int copy(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      Push<false>(L, ArrayView<T>(std::vector<T>(array.begin(), array.end())));
+      return 1;
+    }
+
+    //! Returns the ArrayView at the given index, raising a Lua error if its size differs from array.
+    static ArrayView<T>& check_same_size(lua_State* L, const ArrayView<T>& array, int arg){
+      ArrayView<T>& other = check_array(L, arg);
+      if(other.size() != array.size()){
+        luaL_argerror(L, arg, "arrays have different sizes");
+      }
+      return other;
+    }
+
+    //! array:scale(factor), multiplies every element by factor.
+    static int scale(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      ArrayKernels<T>::scale(array.data(), array.size(), check_element(L, 2));
+      lua_settop(L, 1);
+      return 1;
+    }
+
+    //! array:add(other), adds either a number or an array of the same size.
+    static int add(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      if(lua_type(L, 2) == LUA_TNUMBER){
+        ArrayKernels<T>::add(array.data(), array.size(), check_element(L, 2));
+      } else {
+        ArrayView<T>& other = check_same_size(L, array, 2);
+        ArrayKernels<T>::add(array.data(), array.size(), other.data());
+      }
+      lua_settop(L, 1);
+      return 1;
+    }
+
+    //! array:fma(factor, other), adds factor*other[i] to each element.
+    static int fma(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      T factor = check_element(L, 2);
+      ArrayView<T>& other = check_same_size(L, array, 3);
+      ArrayKernels<T>::fma(array.data(), array.size(), other.data(), factor);
+      lua_settop(L, 1);
+      return 1;
+    }
+
+    //! array:clamp(low, high), limits every element to the range [low, high].
+    static int clamp(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      T low = check_element(L, 2);
+      T high = check_element(L, 3);
+      if(high < low){
+        luaL_argerror(L, 3, "upper limit is less than lower limit");
+      }
+      ArrayKernels<T>::clamp(array.data(), array.size(), low, high);
+      lua_settop(L, 1);
+      return 1;
+    }
+
+    //! array:sum(), returns the sum of all elements.
+    static int sum(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      Push<false>(L, ArrayKernels<T>::sum(array.data(), array.size()));
+      return 1;
+    }
+
+    //! array:dot(other), returns the dot product with an array of the same size.
+    static int dot(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      ArrayView<T>& other = check_same_size(L, array, 2);
+      Push<false>(L, ArrayKernels<T>::dot(array.data(), array.size(), other.data()));
+      return 1;
+    }
+
+    //! array:min(), returns the smallest element, or nil if the array is empty.
+    static int min(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      if(array.empty()){
+        lua_pushnil(L);
+      } else {
+        Push<false>(L, ArrayKernels<T>::min(array.data(), array.size()));
+      }
+      return 1;
+    }
+
+    //! array:max(), returns the largest element, or nil if the array is empty.
+    static int max(lua_State* L){
+      ArrayView<T>& array = check_array(L, 1);
+      if(array.empty()){
+        lua_pushnil(L);
+      } else {
+        Push<false>(L, ArrayKernels<T>::max(array.data(), array.size()));
+      }
+      return 1;
+    }
+
+    //! Pushes the metatable for ArrayView<T>, creating it if necessary.
+    static void push_metatable(lua_State* L){
+      if(lua_rawgetp(L, LUA_REGISTRYINDEX, array_view_registry_entry<T>::get()) == LUA_TTABLE){
+        return;
+      }
+      lua_pop(L, 1);
+
+      lua_createtable(L, 0, 5);
+
+      luaL_Reg methods[] = {
+        {"fill", fill},
+        {"totable", totable},
+        {"copy", copy},
+        {"scale", scale},
+        {"add", add},
+        {"fma", fma},
+        {"clamp", clamp},
+        {"sum", sum},
+        {"dot", dot},
+        {"min", min},
+        {"max", max},
+        {nullptr, nullptr}
+      };
+      luaL_newlib(L, methods);
+      lua_pushcclosure(L, index, 1);
+      lua_setfield(L, -2, "__index");
+
+      lua_pushcfunction(L, newindex);
+      lua_setfield(L, -2, "__newindex");
+      lua_pushcfunction(L, length);
+      lua_setfield(L, -2, "__len");
+      lua_pushcfunction(L, garbage_collect);
+      lua_setfield(L, -2, "__gc");
+      lua_pushliteral(L, "Access restricted");
+      lua_setfield(L, -2, "__metatable");
+
+      lua_pushvalue(L, -1);
+      lua_rawsetp(L, LUA_REGISTRYINDEX, array_view_registry_entry<T>::get());
+    }
+  };
+
+  //! Pushes an ArrayView as a userdata.
+  /*! The elements are not copied.
+   */
+  template<typename T>
+  void PushValueDirect(lua_State* L, ArrayView<T> array){
+    ArrayViewMethods<T>::push_metatable(L);
+    void* storage = lua_newuserdata(L, sizeof(ArrayView<T>));
+    new(storage) ArrayView<T>(std::move(array));
+
+    // Stack is now [metatable, userdata].
+    lua_insert(L, -2);
+    lua_setmetatable(L, -2);
+  }
+
+  //! Reads an ArrayView, referring to the same elements as the userdata.
+  /*! @throws LuaInvalidStackContents The value is not an ArrayView<T>.
+   */
+  template<typename T, bool allow_references>
+  struct ReadDefaultType<ArrayView<T>, allow_references>{
+    static ArrayView<T> Read(lua_State* L, int index){
+      ArrayView<T>* array = ArrayViewMethods<T>::to_array(L, index);
+      if(!array){
+        throw LuaInvalidStackContents("Lua value was not an array of the requested type");
+      }
+      return *array;
+    }
+  };
+}
+
+#endif /* _LUAARRAYVIEW_H_ */
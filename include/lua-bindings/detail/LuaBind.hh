@@ -0,0 +1,193 @@
+#ifndef _LUABIND_H_
+#define _LUABIND_H_
+
+#include <functional>
+#include <type_traits>
+
+#include <lua.hpp>
+
+#include "LuaCallable.hh"
+#include "LuaExceptions.hh"
+#include "LuaPush.hh"
+#include "LuaRead.hh"
+#include "TemplateUtils.hh"
+
+namespace Lua{
+  template<typename FuncType, FuncType func>
+  struct BoundFunction;
+
+  //! A lua_CFunction generated at compile time for a single C++ function.
+  /*! The function pointer is a template parameter, rather than being stored.
+    Nothing is allocated when pushing the function,
+      and each call goes directly to the function, with no virtual call or std::function.
+    The only remaining cost is reading the arguments and pushing the return value.
+   */
+  template<typename RetVal, typename... Params, RetVal (*func)(Params...)>
+  struct BoundFunction<RetVal (*)(Params...), func>{
+    //! The function exposed to Lua.
+    /*! @throws LuaCppCallError The number of arguments passed from Lua is incorrect.
+      Any exception is converted to a Lua error before returning to Lua.
+     */
+    static int call(lua_State* L){
+      try{
+        if(lua_gettop(L) != sizeof...(Params)){
+          throw LuaCppCallError("Incorrect number of arguments passed");
+        }
+        return call_helper_function(build_indices<sizeof...(Params)>(), L);
+      } catch (...) {
+        return cpp_exception_to_lua_error(L);
+      }
+    }
+
+  private:
+    template<int... Indices,
+             typename R = RetVal,
+             typename std::enable_if<!std::is_same<R, void>::value, int>::type = 0
+             >
+    static int call_helper_function(indices<Indices...>, lua_State* L){
+      RetVal output = func(Read<Params, true>(L, Indices+1)...);
+      return PushReturnValue<RetVal>::Push(L, output);
+    }
+
+    // g++ incorrectly flags lua_State* L as being unused when Params... is empty
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-parameter"
+    template<int... Indices,
+             typename R = RetVal,
+             typename std::enable_if<std::is_same<R, void>::value, int>::type = 0
+             >
+    static int call_helper_function(indices<Indices...>, lua_State* L){
+      func(Read<Params, true>(L, Indices+1)...);
+      return 0;
+    }
+#pragma GCC diagnostic pop
+  };
+
+#ifdef __cpp_noexcept_function_type
+  template<typename RetVal, typename... Params, RetVal (*func)(Params...) noexcept>
+  struct BoundFunction<RetVal (*)(Params...) noexcept, func>
+    : BoundFunction<RetVal (*)(Params...), func> { };
+#endif
+
+  //! Implementation of BoundMemberFunction, shared by const and non-const methods.
+  template<typename ClassType, typename MethodType, MethodType method,
+           typename RetVal, typename... Params>
+  struct BoundMemberFunction_Impl{
+    //! The function exposed to Lua.
+    /*! Reads the object from the first argument, then calls the method.
+      As with LuaCallable_MemberFunction, returns nil if the object is no longer valid.
+
+      @throws LuaCppCallError The number of arguments passed from Lua is incorrect.
+      Any exception is converted to a Lua error before returning to Lua.
+     */
+    static int call(lua_State* L){
+      try{
+        if(lua_gettop(L) != sizeof...(Params) + 1){
+          throw LuaCppCallError("Incorrect number of arguments passed");
+        }
+
+        auto ptr = ReadHeldPointer<ClassType>(L, 1);
+
+        ClassType* cptr;
+        try{
+          cptr = static_cast<ClassType*>(ptr.get_c(L));
+        } catch(LuaInvalidStackContents&) {
+          Push(L, LuaNil());
+          return 1;
+        }
+
+        return call_helper_function(build_indices<sizeof...(Params)>(), L, cptr);
+      } catch (...) {
+        return cpp_exception_to_lua_error(L);
+      }
+    }
+
+  private:
+    //! The object is at stack position 1, so the parameters start at 2.
+    template<int... Indices,
+             typename R = RetVal,
+             typename std::enable_if<!std::is_same<R, void>::value, int>::type = 0
+             >
+    static int call_helper_function(indices<Indices...>, lua_State* L, ClassType* obj){
+      RetVal output = (obj->*method)(Read<Params, true>(L, Indices+2)...);
+      return PushReturnValue<RetVal>::Push(L, output);
+    }
+
+    // g++ incorrectly flags lua_State* L as being unused when Params... is empty
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-parameter"
+    template<int... Indices,
+             typename R = RetVal,
+             typename std::enable_if<std::is_same<R, void>::value, int>::type = 0
+             >
+    static int call_helper_function(indices<Indices...>, lua_State* L, ClassType* obj){
+      (obj->*method)(Read<Params, true>(L, Indices+2)...);
+      return 0;
+    }
+#pragma GCC diagnostic pop
+  };
+
+  template<typename ClassType, typename MethodType, MethodType method>
+  struct BoundMemberFunction;
+
+  //! A lua_CFunction generated at compile time for a single method.
+  /*! As with BoundFunction, the method pointer is a template parameter.
+    ClassType is the class registered with MakeClass,
+      which may be a subclass of the class that declares the method.
+   */
+  template<typename ClassType, typename MethodClass, typename RetVal, typename... Params,
+           RetVal (MethodClass::*method)(Params...)>
+  struct BoundMemberFunction<ClassType, RetVal (MethodClass::*)(Params...), method>
+    : BoundMemberFunction_Impl<ClassType, RetVal (MethodClass::*)(Params...), method,
+                               RetVal, Params...> { };
+
+  template<typename ClassType, typename MethodClass, typename RetVal, typename... Params,
+           RetVal (MethodClass::*method)(Params...) const>
+  struct BoundMemberFunction<ClassType, RetVal (MethodClass::*)(Params...) const, method>
+    : BoundMemberFunction_Impl<ClassType, RetVal (MethodClass::*)(Params...) const, method,
+                               RetVal, Params...> { };
+
+  //! Whether a method pointer may be called on a const object.
+  template<typename MethodType>
+  struct is_const_method : std::false_type { };
+
+  template<typename MethodClass, typename RetVal, typename... Params>
+  struct is_const_method<RetVal (MethodClass::*)(Params...) const> : std::true_type { };
+
+#ifdef __cpp_noexcept_function_type
+  template<typename ClassType, typename MethodClass, typename RetVal, typename... Params,
+           RetVal (MethodClass::*method)(Params...) noexcept>
+  struct BoundMemberFunction<ClassType, RetVal (MethodClass::*)(Params...) noexcept, method>
+    : BoundMemberFunction_Impl<ClassType, RetVal (MethodClass::*)(Params...) noexcept, method,
+                               RetVal, Params...> { };
+
+  template<typename ClassType, typename MethodClass, typename RetVal, typename... Params,
+           RetVal (MethodClass::*method)(Params...) const noexcept>
+  struct BoundMemberFunction<ClassType, RetVal (MethodClass::*)(Params...) const noexcept, method>
+    : BoundMemberFunction_Impl<ClassType, RetVal (MethodClass::*)(Params...) const noexcept, method,
+                               RetVal, Params...> { };
+
+  template<typename MethodClass, typename RetVal, typename... Params>
+  struct is_const_method<RetVal (MethodClass::*)(Params...) const noexcept> : std::true_type { };
+#endif
+
+  //! Returns a lua_CFunction that calls the function given as a template parameter.
+  /*! Usage:
+        L.SetGlobal("sum_integers", Lua::Bind<decltype(&sum_integers), &sum_integers>());
+      or, with C++17,
+        L.SetGlobal("sum_integers", Lua::Bind<&sum_integers>());
+   */
+  template<typename FuncType, FuncType func>
+  lua_CFunction Bind(){
+    return BoundFunction<FuncType, func>::call;
+  }
+
+#if __cplusplus >= 201703L
+  template<auto func>
+  lua_CFunction Bind(){
+    return BoundFunction<decltype(func), func>::call;
+  }
+#endif
+}
+
+#endif /* _LUABIND_H_ */
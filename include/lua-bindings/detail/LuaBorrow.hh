@@ -0,0 +1,35 @@
+#ifndef _LUABORROW_H_
+#define _LUABORROW_H_
+
+#include <memory>
+
+namespace Lua{
+  //! A non-owning reference to be passed into Lua, without validity tracking.
+  /*! Constructed with Lua::Borrow().
+   */
+  template<typename T>
+  struct Borrowed{
+    explicit Borrowed(T* ptr) : ptr(ptr) { }
+
+    T* ptr;
+  };
+
+  //! Passes an object to Lua by reference, without checking its lifetime.
+  /*! Equivalent to passing &obj, spelled so that it reads as a reference at the call site.
+      Unlike std::ref/std::cref, no reference id is generated,
+        and the reference does not expire at the end of the call.
+      This avoids the bookkeeping cost for references passed very frequently.
+      The caller must guarantee that the object outlives every use from Lua.
+    The userdata holds only the pointer, with the class metatable,
+      and reads still check the type through the metatable.
+
+    Usage:
+      L.Call("on_update", Lua::Borrow(obj));
+   */
+  template<typename T>
+  Borrowed<T> Borrow(T& obj){
+    return Borrowed<T>(std::addressof(obj));
+  }
+}
+
+#endif /* _LUABORROW_H_ */
@@ -0,0 +1,35 @@
+#ifndef _LUABYTECODECACHE_H_
+#define _LUABYTECODECACHE_H_
+
+#include <string>
+
+#include <lua.hpp>
+
+namespace Lua{
+  //! Prepares a directory for use as a bytecode cache.
+  /*! Creates the directory, with permissions 0700, if it does not exist.
+    Returns false if the directory cannot be created, or is not trusted.
+    A directory is trusted if it is owned by the effective user,
+      and cannot be written by the group or by other users.
+   */
+  bool InitializeBytecodeCache(const std::string& cache_dir);
+
+  //! Loads a file, as PushCodeFile, using compiled bytecode from cache_dir if available.
+  /*! Cache entries are keyed by the path of the file, a hash of its contents,
+        and the version of Lua.
+      Changing the file therefore never loads stale bytecode.
+    If there is no entry, the file is compiled from source,
+      and the bytecode is written to the cache.
+
+    Bytecode is only loaded if both the directory and the cache file are trusted,
+      as described in InitializeBytecodeCache.
+    Otherwise, the cache is ignored, and the file is compiled from source.
+    Failing to write to the cache is not an error.
+
+    @throws LuaFileNotFound The file could not be read.
+    @throws LuaFileParseError The file could not be parsed.
+   */
+  void PushCodeFileCached(lua_State* L, const char* filename, const std::string& cache_dir);
+}
+
+#endif /* _LUABYTECODECACHE_H_ */
@@ -1,6 +1,9 @@
 #ifndef _LUACALLFROMSTACK_H_
 #define _LUACALLFROMSTACK_H_
 
+#include <functional>
+#include <type_traits>
+
 #include <lua.hpp>
 
 namespace Lua{
@@ -14,11 +17,33 @@ namespace Lua{
 #include "LuaReferenceSet.hh"
 
 namespace Lua{
+  template<typename T>
+  struct is_reference_wrapper : std::false_type { };
+
+  template<typename T>
+  struct is_reference_wrapper<std::reference_wrapper<T> > : std::true_type { };
+
+  //! Whether any of the parameters will be pushed as a tracked reference.
+  template<typename... Params>
+  struct contains_reference_wrapper : std::false_type { };
+
+  template<typename First, typename... Rest>
+  struct contains_reference_wrapper<First, Rest...>
+    : std::integral_constant<bool,
+                             is_reference_wrapper<typename std::decay<First>::type>::value ||
+                             contains_reference_wrapper<Rest...>::value> { };
+
+  //! Calls the function on top of the stack.
+  /*! If no parameter is a std::reference_wrapper, no references can be made,
+      and the reference bookkeeping is removed at compile time.
+   */
   template<typename RetVal, typename... Params>
   RetVal CallFromStack(lua_State* L, Params&&... params){
+    const bool track_references = contains_reference_wrapper<Params...>::value;
+
     int top = lua_gettop(L) - 1; // -1 because the function is already on the stack.
-    PreserveValidReferences ref_save(L);
-    PushMany<true>(L, std::forward<Params>(params)...);
+    MaybePreserveValidReferences<track_references> ref_save(L);
+    PushMany<track_references>(L, std::forward<Params>(params)...);
     int result = lua_pcall(L, sizeof...(params), LUA_MULTRET, 0);
     int nresults = lua_gettop(L) - top;
     LuaDelayedPop delayed(L, nresults);
@@ -20,9 +20,25 @@ namespace Lua{
     In addition, the function must interact directly with the lua_State.
     By having a universal callback that then dispatches,
     functions can be exposed to Lua more cleanly.
+
+    Each LuaCallable is pushed as a closure of call_cpp_function,
+      with a userdata holding the LuaCallable* as its only upvalue.
+    The arguments are therefore left in place on the stack.
   */
   int call_cpp_function(lua_State* L);
 
+  //! Returns the LuaCallable at the given stack position.
+  /*! Returns nullptr if the value is not a closure made by pushing a LuaCallable.
+   */
+  LuaCallable* GetLuaCallable(lua_State* L, int index);
+
+  //! Converts the C++ exception currently being handled into a Lua error.
+  /*! Must only be called from within a catch block.
+    Lua cannot unwind through C++ exceptions, so every function called from Lua
+      catches all exceptions and passes them to this.
+   */
+  int cpp_exception_to_lua_error(lua_State* L);
+
   //! Calls the destructor of the LuaCallable.
   /*! As before, I need a C-style function pointer.
    */
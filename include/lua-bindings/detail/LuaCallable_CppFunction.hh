@@ -57,17 +57,7 @@ namespace Lua{
     static int call_helper_function(indices<Indices...>, std::function<RetVal_func(Params...)> func,
                                     lua_State* L){
       RetVal_func output = func(Read<Params, true>(L, Indices+1)...);
-      int top = lua_gettop(L);
-      if(std::is_reference<RetVal_func>::value &&
-         std::is_const<RetVal_func>::value) {
-        Push(L, std::cref(output));
-      } else if (std::is_reference<RetVal_func>::value &&
-                 !std::is_const<RetVal_func>::value){
-          Push(L, std::ref(output));
-      } else {
-        Push(L, output);
-      }
-      return lua_gettop(L) - top;
+      return PushReturnValue<RetVal_func>::Push(L, output);
     }
 
     // g++ incorrectly flags lua_State* L as being unused when Params... is empty
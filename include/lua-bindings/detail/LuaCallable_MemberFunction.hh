@@ -52,7 +52,6 @@ namespace Lua{
       }
 
       auto ptr = ReadHeldPointer<ClassType>(L, 1);
-      lua_remove(L,1);
 
       ClassType* cptr;
       try{
@@ -71,24 +70,15 @@ namespace Lua{
 
     //! As in LuaCallable_CppFunction, needing to extract indices.
     /*! This function is used if RetVal is non-void.
+      The object is at stack position 1, so the parameters start at 2.
      */
     template<int... Indices,
              typename R = RetVal,
              typename std::enable_if<!std::is_same<R, void>::value, int>::type = 0
              >
     int call_member_function_helper(indices<Indices...>, lua_State* L, ClassType* obj){
-      RetVal output = func(obj, Read<Params>(L, Indices+1)...);
-      int top = lua_gettop(L);
-      if(std::is_reference<RetVal>::value &&
-         std::is_const<RetVal>::value) {
-        Push(L, std::cref(output));
-      } else if (std::is_reference<RetVal>::value &&
-                 !std::is_const<RetVal>::value){
-          Push(L, std::ref(output));
-      } else {
-        Push(L, output);
-      }
-      return lua_gettop(L) - top;
+      RetVal output = func(obj, Read<Params, true>(L, Indices+2)...);
+      return PushReturnValue<RetVal>::Push(L, output);
     }
 
     // g++ incorrectly flags lua_State* L as being unused when Params... is empty
@@ -102,7 +92,7 @@ namespace Lua{
              typename std::enable_if<std::is_same<R, void>::value, int>::type = 0
              >
     int call_member_function_helper(indices<Indices...>, lua_State* L, ClassType* obj){
-      func(obj, Read<Params, true>(L, Indices+1)...);
+      func(obj, Read<Params, true>(L, Indices+2)...);
       return 0;
     }
 #pragma GCC diagnostic pop
@@ -0,0 +1,32 @@
+#ifndef _LUACHECKEDINTEGER_H_
+#define _LUACHECKEDINTEGER_H_
+
+#include <type_traits>
+
+namespace Lua{
+  //! An integer that is read from Lua with range checking.
+  /*! By default, integral types are read with lua_tointegerx,
+        falling back to truncating the number if it has a fractional part.
+      When read as a CheckedInteger<T>, the Lua value must instead be an integer
+        (or a float with an exact integer representation)
+        that fits into T, otherwise an exception is thrown.
+    An unsigned T as wide as lua_Integer accepts every Lua integer.
+      Values above the maximum lua_Integer are pushed as negative integers,
+      with the same bit pattern, as Lua itself does for unsigned arithmetic.
+
+    Usage:
+      L.SetGlobal("set_id", [](Lua::CheckedInteger<uint32_t> id){ ... });
+   */
+  template<typename T>
+  struct CheckedInteger{
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                  "CheckedInteger requires an integral type");
+
+    CheckedInteger(T value = 0) : value(value) { }
+    operator T() const { return value; }
+
+    T value;
+  };
+}
+
+#endif /* _LUACHECKEDINTEGER_H_ */
@@ -0,0 +1,48 @@
+#ifndef _LUACHUNK_H_
+#define _LUACHUNK_H_
+
+#include <memory>
+#include <utility>
+
+#include <lua.hpp>
+
+#include "LuaCallFromStack.hh"
+#include "LuaFunctionWrapper.hh"
+
+namespace Lua{
+  //! A compiled chunk of Lua code, which can be run repeatedly.
+  /*! Returned by LuaState::Compile.
+    The code is parsed once, and the resulting function is held in the registry.
+    Running the chunk calls that function, without parsing the code again.
+    Copies of the chunk share the same function.
+    The lua_State is kept alive for as long as any copy exists.
+
+    Arguments are available within the chunk as "...".
+
+    Usage:
+      auto rule = L.Compile("local x = ... return x > 10", "=rule");
+      bool result = rule.Run<bool>(15);
+   */
+  class Chunk{
+  public:
+    Chunk(std::shared_ptr<lua_State> shared_L, int index)
+      : wrapper(std::make_shared<FunctionWrapper>(std::move(shared_L), index)) { }
+
+    //! Runs the chunk.
+    /*! Parameters are passed in the same way as LuaState::Call.
+
+      @throws LuaInvalidStackContents The return value cannot be converted to the requested type.
+      @throws LuaExecuteError A lua error occurred during execution.
+     */
+    template<typename RetVal=void, typename... Params>
+    RetVal Run(Params&&... params) const {
+      lua_State* L = wrapper->PushFunction();
+      return CallFromStack<RetVal>(L, std::forward<Params>(params)...);
+    }
+
+  private:
+    std::shared_ptr<FunctionWrapper> wrapper;
+  };
+}
+
+#endif /* _LUACHUNK_H_ */
@@ -0,0 +1,77 @@
+#ifndef _LUACHUNKREADER_H_
+#define _LUACHUNKREADER_H_
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <lua.hpp>
+
+namespace Lua{
+  //! Supplies Lua code to LuaState::LoadStream, one block at a time.
+  /*! The code is passed directly to lua_load, without being collected into a single string.
+   */
+  class ChunkReader{
+  public:
+    virtual ~ChunkReader() { }
+
+    //! Returns the next block of code, and sets size to its length.
+    /*! Returns nullptr, or sets size to 0, at the end of the code.
+      The block must remain valid until the next call to Read,
+        or until the ChunkReader is destroyed.
+      Any exception thrown is passed on by LoadStream.
+     */
+    virtual const char* Read(size_t& size) = 0;
+  };
+
+  //! Reads a file by mapping it into memory.
+  /*! The entire file is given to Lua as a single block, without being copied.
+    Unlike LuaState::LoadFile, a leading '#' line is not skipped.
+    The file is mapped by the constructor, and unmapped by the destructor.
+   */
+  class MappedFileReader : public ChunkReader{
+  public:
+    //! @throws LuaFileNotFound The file could not be opened or mapped.
+    MappedFileReader(const char* filename);
+    ~MappedFileReader();
+
+    MappedFileReader(const MappedFileReader&) = delete;
+    MappedFileReader& operator=(const MappedFileReader&) = delete;
+
+    const char* Read(size_t& size) override;
+
+  private:
+    void* data;
+    size_t length;
+    bool finished;
+
+    //! Holds the contents, where mapping files into memory is not supported.
+    std::string fallback;
+  };
+
+  //! Reads from a std::istream, in blocks of a fixed size.
+  /*! Useful for pipes, decompressed archives, or any other source
+      whose size is not known in advance.
+   */
+  class StreamReader : public ChunkReader{
+  public:
+    StreamReader(std::istream& stream, size_t block_size = 64*1024);
+
+    //! @throws LuaStreamReadError The stream reported an error, rather than the end of input.
+    const char* Read(size_t& size) override;
+
+  private:
+    std::istream& stream;
+    std::vector<char> buffer;
+  };
+
+  //! Loads Lua code from a ChunkReader, without running it.
+  /*! The chunkname is used in error messages, and follows the conventions of lua_load.
+
+    @throws LuaFileParseError The code could not be parsed.
+   */
+  void PushCodeStream(lua_State* L, ChunkReader& reader, const char* chunkname);
+}
+
+#endif /* _LUACHUNKREADER_H_ */
@@ -14,10 +14,13 @@ namespace Lua {
   };
 
   Exception(LuaException, LuaFileNotFound);
+  Exception(LuaException, LuaStreamReadError);
   Exception(LuaException, LuaInvalidStackContents);
   Exception(LuaInvalidStackContents, LuaIncorrectPointerType);
   Exception(LuaInvalidStackContents, LuaExpiredWeakPointer);
   Exception(LuaInvalidStackContents, LuaExpiredReference);
+  Exception(LuaInvalidStackContents, LuaIntegerConversionError);
+  Exception(LuaInvalidStackContents, LuaTableIndexOutOfRange);
   Exception(LuaException, LuaFileParseError);
 
   Exception(LuaException, LuaExecuteError);
@@ -18,10 +18,40 @@ namespace Lua {
 
     template<typename RetVal=void, typename... Params>
     RetVal Call(Params&&... params);
+
+    //! Pushes the function onto the stack, returning the lua_State that holds it.
+    lua_State* PushFunction() const;
   private:
     std::shared_ptr<lua_State> shared_L;
     int reference;
   };
+
+  template<typename T>
+  class LuaFunction;
+
+  //! A typed handle to a Lua function.
+  /*! Holds a reference to the function in the registry,
+      so calling it does not look up the function by name.
+    Copies of the handle share the same reference.
+    The lua_State is kept alive for as long as any copy exists.
+   */
+  template<typename RetVal, typename... Params>
+  class LuaFunction<RetVal(Params...)>{
+  public:
+    LuaFunction(std::shared_ptr<lua_State> shared_L, int index)
+      : wrapper(std::make_shared<FunctionWrapper>(std::move(shared_L), index)) { }
+
+    //! Calls the Lua function.
+    /*! @throws LuaInvalidStackContents The return value cannot be converted to the requested type.
+      @throws LuaFunctionExecuteError A lua error occurred during execution.
+     */
+    RetVal operator()(Params... params) const {
+      return wrapper->Call<RetVal>(std::forward<Params>(params)...);
+    }
+
+  private:
+    std::shared_ptr<FunctionWrapper> wrapper;
+  };
 }
 
 #include "LuaCallFromStack.hh"
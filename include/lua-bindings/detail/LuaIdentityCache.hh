@@ -0,0 +1,33 @@
+#ifndef _LUAIDENTITYCACHE_H_
+#define _LUAIDENTITYCACHE_H_
+
+#include <lua.hpp>
+
+namespace Lua{
+  //! The kinds of pointer that may be held in the identity cache.
+  /*! Each kind has its own cache, so that an address pushed as a raw pointer
+        is never returned when pushing a shared_ptr, or vice versa.
+   */
+  enum class IdentityCacheKind { SharedPointer, CPointer };
+
+  //! Enables the identity cache for the lua_State.
+  /*! Once enabled, pushing the same object again, as the same type and pointer kind,
+        returns the userdata that was previously pushed, if Lua still holds it.
+      The cache holds its values weakly, so it does not keep objects alive.
+   */
+  void EnableIdentityCache(lua_State* L);
+
+  //! Pushes the userdata previously pushed for an object, if one is cached.
+  /*! Returns true if a userdata was pushed.
+    Returns false, leaving the stack unchanged,
+      if the cache is disabled or holds no userdata for the object.
+   */
+  bool PushCachedIdentity(lua_State* L, IdentityCacheKind kind, void* class_key, const void* address);
+
+  //! Stores the userdata on top of the stack as the identity of the object.
+  /*! Does nothing if the cache is disabled.
+   */
+  void CacheIdentity(lua_State* L, IdentityCacheKind kind, void* class_key, const void* address);
+}
+
+#endif /* _LUAIDENTITYCACHE_H_ */
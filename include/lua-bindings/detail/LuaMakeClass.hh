@@ -9,6 +9,7 @@
 
 #include <lua.hpp>
 
+#include "LuaBind.hh"
 #include "LuaCallable_MemberFunction.hh"
 #include "LuaCallable_ObjectConstructor.hh"
 #include "LuaObject.hh"
@@ -55,6 +56,31 @@ namespace Lua{
       return *this;
     }
 
+    //! Adds a method, with the method pointer known at compile time.
+    /*! Usage:
+          L.MakeClass<ClassName>("ClassName")
+            .AddMethod<decltype(&ClassName::Method1), &ClassName::Method1>("Method1");
+        or, with C++17,
+          L.MakeClass<ClassName>("ClassName")
+            .AddMethod<&ClassName::Method1>("Method1");
+
+      Each method gets its own lua_CFunction, so the call can be inlined,
+        and nothing is allocated for the method.
+     */
+    template<typename MethodType, MethodType method>
+    MakeClass& AddMethod(std::string method_name){
+      const_index.template AddMethod<MethodType, method>(method_name);
+      nonconst_index.template AddMethod<MethodType, method>(method_name);
+      return *this;
+    }
+
+#if __cplusplus >= 201703L
+    template<auto method>
+    MakeClass& AddMethod(std::string method_name){
+      return AddMethod<decltype(method), method>(method_name);
+    }
+#endif
+
     template<typename... Params>
     MakeClass& AddConstructor(std::string constructor_name = ""){
       if(constructor_name.size() == 0){
@@ -87,10 +113,10 @@ namespace Lua{
       }
 
       ~ClassIndexGen() {
-        LuaObject registry(L, LUA_REGISTRYINDEX);
-        BaseClassInit(registry, true);
+        BaseClassInit(true);
         metatable["__index"] = index;
-        registry[class_registry_entry<IClass>::get()] = metatable;
+        lua_pushvalue(L, metatable.StackPos());
+        lua_rawsetp(L, LUA_REGISTRYINDEX, class_registry_entry<IClass>::get());
       }
 
       // Disable adding a non-const method to a const index.
@@ -107,22 +133,40 @@ namespace Lua{
         index[method_name] = new LuaCallable_MemberFunction<IClass, RetVal(Params...)>(func);
       }
 
+      // Non-const methods are only added to the non-const index.
+      template<typename MethodType, MethodType method>
+      typename std::enable_if<!std::is_const<IClass>::value ||
+                              is_const_method<MethodType>::value>::type
+      AddMethod(std::string method_name){
+        index[method_name] = &BoundMemberFunction<IClass, MethodType, method>::call;
+      }
+
+      template<typename MethodType, MethodType method>
+      typename std::enable_if<std::is_const<IClass>::value &&
+                              !is_const_method<MethodType>::value>::type
+      AddMethod(std::string){ }
+
     private:
       // Base class exists, make the metatable point to it.
       template<typename T = IBase>
       typename std::enable_if<!std::is_same<typename std::decay<T>::type, void>::value>::type
-      BaseClassInit(LuaObject& registry,bool) {
+      BaseClassInit(bool) {
         NewTable(L);
         LuaObject index_metatable(L);
         {
-          LuaObject base_metatable = registry[class_registry_entry<IBase>::get()].Get();
+          GetClassMetatable<IBase>(L);
+          LuaObject base_metatable(L, -1);
           LuaDelayedPop delayed(L,1);
           index_metatable["__index"].Set(base_metatable["__index"]);
+
+          // Used by Lua::Read to find the upcasters to a base class.
+          lua_pushvalue(L, base_metatable.StackPos());
+          lua_setfield(L, metatable.StackPos(), "base");
         }
 
         if(!std::is_same<typename std::decay<IBase>::type, void>::value) {
-          Upcaster* upcaster = new Upcaster_Impl<typename std::decay<IBase>::type,
-                                                 typename std::decay<IClass>::type>();
+          Upcaster* upcaster = new Upcaster(MakeUpcaster<typename std::decay<IBase>::type,
+                                                         typename std::decay<IClass>::type>());
           metatable["upcaster"] = upcaster;
         }
 
@@ -131,7 +175,7 @@ namespace Lua{
       }
 
       // No base class, do nothing.
-      void BaseClassInit(LuaObject&,int) { }
+      void BaseClassInit(int) { }
 
       lua_State* L;
       std::string name;
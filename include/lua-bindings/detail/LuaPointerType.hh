@@ -1,9 +1,11 @@
 #ifndef _LUAPOINTERTYPE_H_
 #define _LUAPOINTERTYPE_H_
 
+#include <cstddef>
 #include <iostream>
 #include <memory>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <lua.hpp>
@@ -24,54 +26,143 @@ namespace Lua{
     return std::static_pointer_cast<T>(std::move(shared));
   }
 
-  //! Base class for C++ objects being held by Lua.
+  //! A C++ object being held by Lua.
   /*!
-    This can be stored inside Lua userdata.
+    This is stored inside Lua userdata.
     The get_shared, get_weak, and get_c functions return a pointer of the requested type.
     If the pointer cannot be converted to the requested type,
       a LuaInvalidStackContents will be thrown.
+
+    Rather than a virtual function per type of pointer,
+      the kind of pointer held is stored as a tag.
+    The raw pointer is always stored directly,
+      so get_c is a field load for everything but a weak_ptr or a reference,
+      and never modifies a reference count.
+    Anything else needed by a kind of pointer is stored by a subclass,
+      so that each userdata only holds what its kind needs.
    */
   class HeldPointer {
   public:
-    virtual ~HeldPointer() { }
+    enum class Kind { SharedPointer, WeakPointer, CPointer, Reference, Value, Custom };
+
+    Kind GetKind() const { return kind; }
+
+    //! Identifies the type of smart pointer held, for Kind::Custom.
+    /*! nullptr for every other kind.
+     */
+    const void* GetCustomType() const;
 
-    virtual std::shared_ptr<void> get_shared() = 0;
-    virtual std::weak_ptr<void> get_weak() = 0;
-    virtual void* get_c(lua_State* L) = 0;
+    std::shared_ptr<void> get_shared();
+    std::weak_ptr<void> get_weak();
+    void* get_c(lua_State* L);
 
     static int garbage_collect(lua_State* L) {
       void* storage = lua_touserdata(L, 1);
       HeldPointer* ptr = *static_cast<HeldPointer**>(storage);
-      ptr->~HeldPointer();
+      if(ptr->destroy){
+        ptr->destroy(ptr);
+      }
 
       return 0;
     }
+
+  protected:
+    //! Used by subclasses, which hold anything else needed for their kind of pointer.
+    /*! destroy is called by __gc, and must destruct the subclass.
+      It may be nullptr if the subclass is trivially destructible.
+     */
+    HeldPointer(Kind kind, void* raw, void (*destroy)(HeldPointer*))
+      : kind(kind), raw(raw), destroy(destroy) { }
+
+    Kind kind;
+    void* raw;
+
+  private:
+    void (*destroy)(HeldPointer*);
   };
 
   //! A shared_ptr being held by the lua_State.
-  template<typename T>
   class VariableSharedPointer : public HeldPointer {
   public:
-    VariableSharedPointer(std::shared_ptr<T> shared)
-      : ptr(shared) { }
-
-    virtual std::shared_ptr<void> get_shared() { return ptr; }
-    virtual std::weak_ptr<void> get_weak() { return ptr; }
-    virtual void* get_c(lua_State*) { return ptr.get(); }
+    VariableSharedPointer(std::shared_ptr<void> shared)
+      : HeldPointer(Kind::SharedPointer, shared.get(), &VariableSharedPointer::destroy_pointer),
+        ptr(std::move(shared)) { }
 
   private:
-    std::shared_ptr<T> ptr;
+    friend class HeldPointer;
+
+    static void destroy_pointer(HeldPointer* held) {
+      static_cast<VariableSharedPointer*>(held)->~VariableSharedPointer();
+    }
+
+    std::shared_ptr<void> ptr;
   };
 
-  //! A weak_ptr being held by the lua_State.
-  template<typename T>
+  //! A weak_ptr being held by the lua_State, along with the pointer it held when pushed.
   class VariableWeakPointer : public HeldPointer {
   public:
-    VariableWeakPointer(std::weak_ptr<T> weak)
-      : ptr(weak) { }
+    VariableWeakPointer(std::weak_ptr<void> weak, void* raw)
+      : HeldPointer(Kind::WeakPointer, raw, &VariableWeakPointer::destroy_pointer),
+        ptr(std::move(weak)) { }
+
+  private:
+    friend class HeldPointer;
+
+    static void destroy_pointer(HeldPointer* held) {
+      static_cast<VariableWeakPointer*>(held)->~VariableWeakPointer();
+    }
 
-    virtual std::shared_ptr<void> get_shared() {
-      auto output = ptr.lock();
+    std::weak_ptr<void> ptr;
+  };
+
+  //! A C-style pointer being held by the lua_State, without any lifetime tracking.
+  /*! Nothing is stored beyond the pointer itself.
+   */
+  class VariableCPointer : public HeldPointer {
+  public:
+    VariableCPointer(void* raw)
+      : HeldPointer(Kind::CPointer, raw, nullptr) { }
+  };
+
+  //! A C++ reference being held by the lua_State, valid as long as the reference is valid.
+  class VariableReference : public HeldPointer {
+  public:
+    VariableReference(void* raw, ReferenceID reference_id)
+      : HeldPointer(Kind::Reference, raw, nullptr), reference_id(reference_id) { }
+
+  private:
+    friend class HeldPointer;
+
+    ReferenceID reference_id;
+  };
+
+  //! Base class of VariableCustomPointer, identifying the type of smart pointer held.
+  class HeldCustomPointer : public HeldPointer {
+  protected:
+    HeldCustomPointer(void (*destroy)(HeldPointer*), const void* custom_type)
+      : HeldPointer(Kind::Custom, nullptr, destroy), custom_type(custom_type) { }
+
+  private:
+    friend class HeldPointer;
+
+    const void* custom_type;
+  };
+
+  inline const void* HeldPointer::GetCustomType() const {
+    if(kind == Kind::Custom){
+      return static_cast<const HeldCustomPointer*>(this)->custom_type;
+    } else {
+      return nullptr;
+    }
+  }
+
+  inline std::shared_ptr<void> HeldPointer::get_shared() {
+    switch(kind){
+    case Kind::SharedPointer:
+      return static_cast<VariableSharedPointer*>(this)->ptr;
+
+    case Kind::WeakPointer: {
+      auto output = static_cast<VariableWeakPointer*>(this)->ptr.lock();
       if(output) {
         return output;
       } else {
@@ -79,60 +170,137 @@ namespace Lua{
       }
     }
 
-    virtual std::weak_ptr<void> get_weak() { return ptr; }
-    virtual void* get_c(lua_State*) { return get_shared().get(); }
-
-  private:
-    std::weak_ptr<T> ptr;
-  };
+    case Kind::CPointer:
+    case Kind::Reference:
+      throw LuaIncorrectPointerType("Cannot convert C-style pointer to shared_ptr");
 
-  //! A C-style pointer being held by the lua_State
-  template<typename T>
-  class VariableCPointer : public HeldPointer {
-  public:
-    VariableCPointer(T* cptr, unsigned long reference_id)
-      : ptr(cptr), reference_id(reference_id) { }
+    case Kind::Custom:
+      throw LuaIncorrectPointerType("Cannot convert object held by a custom smart pointer to shared_ptr");
 
-    virtual std::shared_ptr<void> get_shared() {
-      throw LuaIncorrectPointerType("Cannot convert C-style pointer to shared_ptr");
+    default:
+      throw LuaIncorrectPointerType("Cannot convert object held by value to shared_ptr");
     }
+  }
+
+  inline std::weak_ptr<void> HeldPointer::get_weak() {
+    switch(kind){
+    case Kind::SharedPointer:
+      return static_cast<VariableSharedPointer*>(this)->ptr;
 
-    virtual std::weak_ptr<void> get_weak() {
+    case Kind::WeakPointer:
+      return static_cast<VariableWeakPointer*>(this)->ptr;
+
+    case Kind::CPointer:
+    case Kind::Reference:
       throw LuaIncorrectPointerType("Cannot convert C-style pointer to weak_ptr");
+
+    case Kind::Custom:
+      throw LuaIncorrectPointerType("Cannot convert object held by a custom smart pointer to weak_ptr");
+
+    default:
+      throw LuaIncorrectPointerType("Cannot convert object held by value to weak_ptr");
     }
+  }
+
+  inline void* HeldPointer::get_c(lua_State* L) {
+    switch(kind){
+    case Kind::WeakPointer:
+      // Only reads the reference count, rather than locking.
+      if(static_cast<VariableWeakPointer*>(this)->ptr.expired()){
+        throw LuaExpiredWeakPointer("Weak_ptr returned was no longer valid");
+      }
+      return raw;
 
-    virtual void* get_c(lua_State* L) {
-      if(IsValidReference(L, reference_id)) {
-        return const_cast<typename std::remove_const<T>::type*>(ptr);
+    case Kind::Reference:
+      if(IsValidReference(L, static_cast<VariableReference*>(this)->reference_id)) {
+        return raw;
       } else {
         throw LuaExpiredReference("C++ reference was no longer valid");
       }
+
+    default:
+      return raw;
+    }
+  }
+
+  //! An object stored by value, directly inside the Lua userdata.
+  /*! Used for objects pushed by value,
+        which are owned by Lua and not shared with anything in C++.
+      The object is destroyed by __gc, along with the rest of the userdata.
+    Since nothing else owns the object, it cannot be read as a shared_ptr or weak_ptr.
+   */
+  template<typename T>
+  class VariableValue : public HeldPointer {
+  public:
+    template<typename... Args>
+    VariableValue(Args&&... args)
+      : HeldPointer(Kind::Value, nullptr, &VariableValue::destroy_value),
+        value(std::forward<Args>(args)...) {
+      raw = const_cast<typename std::remove_const<T>::type*>(std::addressof(value));
     }
 
   private:
-    T* ptr;
-    unsigned long reference_id;
+    static void destroy_value(HeldPointer* ptr) {
+      static_cast<VariableValue*>(ptr)->~VariableValue();
+    }
+
+    T value;
   };
 
   //! Upcasts from a particular class to base class.
   /*!
-    Class designed to be stored for each class known by the LuaState.
+    Stored for each class known by the LuaState that has a base class.
     At the time of Lua::Read, the derived class is not known.
     This allows Lua::Read to upcast until it reaches the base class.
+
+    A function generated for the pair of classes performs the cast.
+    When the base class is not virtual, the base class is at a fixed offset.
+    The offset is measured on the first object upcast,
+      and every later upcast is a single addition.
    */
   class Upcaster {
   public:
-    virtual ~Upcaster() { }
+    Upcaster(void* (*cast)(void*), bool fixed_offset)
+      : cast(cast), fixed_offset(fixed_offset), offset_known(false), offset(0) { }
+
+    void* upcast(void* derived_void) const {
+      if(!derived_void){
+        return nullptr;
+      } else if(offset_known){
+        return static_cast<char*>(derived_void) + offset;
+      }
+
+      void* base_void = cast(derived_void);
+      if(fixed_offset){
+        offset = static_cast<char*>(base_void) - static_cast<char*>(derived_void);
+        offset_known = true;
+      }
+      return base_void;
+    }
 
-    virtual std::shared_ptr<void> upcast(std::shared_ptr<void> derived_void) = 0;
-    virtual std::weak_ptr<void> upcast(std::weak_ptr<void> derived_void) = 0;
-    virtual void* upcast(void* derived_void) = 0;
+  private:
+    void* (*cast)(void*);
+    bool fixed_offset;
+    mutable bool offset_known;
+    mutable std::ptrdiff_t offset;
   };
 
   //! Function to be set as __gc for each Upcaster stored.
   int garbage_collect_upcaster(lua_State* L);
 
-  //! Implementation of the upcaster, for a given
+  //! Whether Base is a non-virtual base of Derived.
+  /*! Checks whether a downcast with static_cast is well-formed,
+      which is not the case for a virtual base.
+   */
+  template<typename Base, typename Derived, typename = void>
+  struct has_fixed_base_offset : std::false_type { };
+
+  template<typename Base, typename Derived>
+  struct has_fixed_base_offset<Base, Derived,
+                               decltype(void(static_cast<Derived*>(std::declval<Base*>())))>
+    : std::true_type { };
+
+  //! Performs the upcast through the type system.
   /*! Objects held by lua must be held as void*.
     When they are cast from the void*, they must be cast to the identical type that they started as.
     This causes issues when casting to a base class, because the object must first be cast to child class.
@@ -147,62 +315,84 @@ namespace Lua{
     The pointer to a base class is not necessary the same numerical value as a pointer to child class.
    */
   template<typename Base, typename Derived>
-  class Upcaster_Impl : public Upcaster {
-  public:
-    virtual std::shared_ptr<void> upcast(std::shared_ptr<void> derived_void) {
-      std::shared_ptr<Derived> derived = std::static_pointer_cast<Derived>(derived_void);
-      std::shared_ptr<Base> base = derived;
-      return std::shared_ptr<void>(base);
-    }
+  void* upcast_function(void* derived_void){
+    Derived* derived = static_cast<Derived*>(derived_void);
+    Base* base = derived;
+    return base;
+  }
 
-    virtual std::weak_ptr<void> upcast(std::weak_ptr<void> derived_void) {
-      std::shared_ptr<void> shared_void = derived_void.lock();
-      return upcast(shared_void);
-    }
+  template<typename Base, typename Derived>
+  Upcaster MakeUpcaster(){
+    return Upcaster(upcast_function<Base, Derived>, has_fixed_base_offset<Base, Derived>::value);
+  }
 
-    virtual void* upcast(void* derived_void) {
-      Derived* derived = static_cast<Derived*>(derived_void);
-      Base* base = derived;
-      return base;
-    }
-  };
+  //! Finds the upcasters needed to read the object's class as the requested class.
+  /*! Expects the metatable of the object to be on top of the stack.
+    Walks up the "base" entries of the metatables until reaching the requested class,
+      or the non-const version of the requested class.
+    Pushes a userdata holding each Upcaster* needed, in order,
+      or false if the object cannot be read as the requested class.
+
+    If the metatable belongs to a registered class,
+      the result is also stored in the metatable, keyed by class_key.
+    A failure is only stored if the requested class has been registered.
+    The userdata holding the upcasters keeps them alive,
+      even if the class is registered again with MakeClass.
+   */
+  void PushUpcastChain(lua_State* L, void* class_key, void* nonconst_class_key);
 
   //! A helper class, to allow grabbing of the pointer and upcasting as necessary.
   /*! Holds a pointer, and all the upcasters needed to convert it to the base class.
     When requested, will get the pointer, then upcast it all the way to the base class.
+    Shared pointers are upcast with the aliasing constructor,
+      so that the reference count is only modified once.
+    The upcasters are not owned, and must outlive the PointerAccess.
    */
   class PointerAccess {
   public:
-    PointerAccess(HeldPointer* p, std::vector<Upcaster*> upcasters)
-      : p(p), upcasters(upcasters) { }
+    PointerAccess(HeldPointer* p, Upcaster* const* upcasters, size_t num_upcasters)
+      : p(p), upcasters(upcasters), num_upcasters(num_upcasters) { }
 
     std::shared_ptr<void> get_shared() {
       auto output = p->get_shared();
-      for(auto upcaster : upcasters) {
-        output = upcaster->upcast(output);
+      if(num_upcasters) {
+        output = std::shared_ptr<void>(output, upcast(output.get()));
       }
       return output;
     }
 
     std::weak_ptr<void> get_weak() {
       auto output = p->get_weak();
-      for(auto upcaster : upcasters) {
-        output = upcaster->upcast(output);
+      if(num_upcasters) {
+        auto shared = output.lock();
+        output = std::shared_ptr<void>(shared, upcast(shared.get()));
       }
       return output;
     }
 
     void* get_c(lua_State* L) {
-      auto output = p->get_c(L);
-      for(auto upcaster : upcasters) {
-        output = upcaster->upcast(output);
+      return upcast(p->get_c(L));
+    }
+
+    HeldPointer::Kind GetKind() const {
+      return p->GetKind();
+    }
+
+    const void* GetCustomType() const {
+      return p->GetCustomType();
+    }
+
+  private:
+    void* upcast(void* output) const {
+      for(size_t i=0; i<num_upcasters; i++) {
+        output = upcasters[i]->upcast(output);
       }
       return output;
     }
 
-  private:
     HeldPointer* p;
-    std::vector<Upcaster*> upcasters;
+    Upcaster* const* upcasters;
+    size_t num_upcasters;
   };
 }
 
@@ -8,17 +8,26 @@
 #include <memory>
 #include <set>
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 #include <tuple>
 #include <type_traits>
 #include <vector>
 
 #include <lua.hpp>
 
+#include "LuaBorrow.hh"
+#include "LuaCheckedInteger.hh"
 #include "LuaExceptions.hh"
+#include "LuaIdentityCache.hh"
 #include "LuaNil.hh"
 #include "LuaObject.hh"
 #include "LuaPointerType.hh"
+#include "LuaReflect.hh"
 #include "LuaRegistryNames.hh"
+#include "LuaSmartPointer.hh"
+#include "LuaStringRef.hh"
 #include "TemplateUtils.hh"
 
 namespace Lua{
@@ -34,8 +43,12 @@ namespace Lua{
    */
   void PushValueDirect(lua_State* L, lua_CFunction t);
   void PushValueDirect(lua_State* L, const char* string);
-  void PushValueDirect(lua_State* L, std::string string);
-  void PushValueDirect(lua_State* L, LuaObject& obj);
+  void PushValueDirect(lua_State* L, const std::string& string);
+  void PushValueDirect(lua_State* L, StringRef string);
+#if __cplusplus >= 201703L
+  void PushValueDirect(lua_State* L, std::string_view string);
+#endif
+  void PushValueDirect(lua_State* L, LuaObject obj);
   void PushValueDirect(lua_State* L, LuaCallable* callable);
   void PushValueDirect(lua_State* L, Upcaster* upcaster);
   void PushValueDirect(lua_State* L, bool b);
@@ -48,10 +61,21 @@ namespace Lua{
   template<bool accept_references = false, typename FirstParam, typename... Params>
   void PushMany(lua_State* L, FirstParam&& first, Params&&... params);
 
+  //! Integral types are pushed as Lua integers, floating point types as Lua floats.
+  /*! Unsigned values larger than the maximum lua_Integer wrap around,
+      following Lua's own convention for unsigned integers.
+   */
   template<typename T>
-  typename std::enable_if<std::is_arithmetic<T>::value>::type
+  typename std::enable_if<std::is_integral<T>::value>::type
   PushValueDirect(lua_State* L, T t);
 
+  template<typename T>
+  typename std::enable_if<std::is_floating_point<T>::value>::type
+  PushValueDirect(lua_State* L, T t);
+
+  template<typename T>
+  void PushValueDirect(lua_State* L, CheckedInteger<T> t);
+
   template<typename RetVal, typename... Params>
   void PushValueDirect(lua_State* L, std::function<RetVal(Params...)> func);
 
@@ -61,21 +85,38 @@ namespace Lua{
   template<typename RetVal, typename... Params>
   void PushValueDirect(lua_State* L, RetVal (*func)(Params...));
 
-  template<typename T>
-  typename std::enable_if<std::is_arithmetic<T>::value>::type
-  PushValueDirect(lua_State* L, T t);
 
   template<typename T>
   class LuaCallable_CppFunction;
   template<typename RetVal, typename... Params>
   void PushValueDirect(lua_State* L, std::function<RetVal(Params...)> func);
 
+  //! Constructs a HeldPointer, or subclass, inside a new userdata.
+  /*! Expects the metatable to be on top of the stack,
+      and replaces it with the userdata.
+   */
+  template<typename Held, typename... Args>
+  void PushHeldPointer(lua_State* L, Args&&... args);
+
+  //! Constructs an object inside a new userdata, holding it by value.
+  /*! The object is destroyed when the userdata is garbage-collected.
+   */
+  template<typename T, typename... Args>
+  void PushValueInPlace(lua_State* L, Args&&... args);
+
   template<typename T>
   void PushValueDirect(lua_State* L, std::shared_ptr<T> t);
 
   template<typename T>
   void PushValueDirect(lua_State* L, std::weak_ptr<T> t);
 
+  //! Pushes a user-defined smart pointer, as described by SmartPointerTraits.
+  /*! A null pointer is pushed as nil.
+   */
+  template<typename Ptr>
+  typename std::enable_if<has_smart_pointer_traits<typename std::decay<Ptr>::type>::value>::type
+  PushValueDirect(lua_State* L, Ptr&& ptr);
+
   // LuaCallable and Upcaster are the only thing that is currently pushed by pointer.
   // Need the std::enable_if to make sure that this doesn't override that behavior.
   template<typename T>
@@ -86,17 +127,28 @@ namespace Lua{
   template<typename RetVal, typename... Params>
   void PushValueDirect(lua_State* L, RetVal (*func)(Params...));
 
+  //! Pushes a reference that is not tracked, and so never expires.
+  template<typename T>
+  void PushValueDirect(lua_State* L, Borrowed<T> borrowed);
+
   template<int... Indices, typename... Params>
-  void PushValueDirect_TupleHelper(lua_State* L, std::tuple<Params...> tuple, indices<Indices...>);
+  void PushValueDirect_TupleHelper(lua_State* L, std::tuple<Params...>&& tuple, indices<Indices...>);
 
   template<typename... Params>
   void PushValueDirect(lua_State* L, std::tuple<Params...> tuple);
 
+  //! Pushes a std::vector<T> as a new table, with keys 1 through vec.size().
+  template<typename T>
+  void PushValueDirect(lua_State* L, const std::vector<T>& vec);
+
+  //! Pushes a std::map<std::string, T> as a new table.
   template<typename T>
-  void PushValueDirect(lua_State* L, std::vector<T> vec);
+  void PushValueDirect(lua_State* L, const std::map<std::string, T>& map);
 
+  //! Pushes a struct described by LUA_REFLECT as a new table, with one entry per field.
   template<typename T>
-  void PushValueDirect(lua_State* L, std::map<std::string, T> map);
+  typename std::enable_if<is_reflected<T>::value>::type
+  PushValueDirect(lua_State* L, const T& t);
 
   // Need separate specialization for l-value reference, r-value reference.
   // Otherwise, it will try to make a std::shared_ptr<T&>, which is nonsensical.
@@ -117,8 +169,8 @@ namespace Lua{
   };
 
   template<bool track_references, typename T>
-  auto PushDirectIfPossible(lua_State* L, T t, bool)
-    -> decltype(PushValueDirect(L, t));
+  auto PushDirectIfPossible(lua_State* L, T&& t, bool)
+    -> decltype(PushValueDirect(L, std::forward<T>(t)));
 
   template<bool track_references, typename T>
   void PushDirectIfPossible(lua_State* L, T&& t, int);
@@ -133,6 +185,21 @@ namespace Lua{
   template<bool track_references = false, typename T>
   void Push(lua_State* L, T&& t);
 
+  //! Pushes the return value of a function called from Lua.
+  /*! Returns the number of values pushed.
+    Values are moved onto the stack, since the returned object is no longer needed.
+    References are pushed as references, so that Lua can modify the original object.
+   */
+  template<typename RetVal>
+  struct PushReturnValue{
+    static int Push(lua_State* L, RetVal& output);
+  };
+
+  template<typename T>
+  struct PushReturnValue<T&>{
+    static int Push(lua_State* L, T& output);
+  };
+
   //! Does nothing.  Needed for end of recursion of PushMany
   template<bool track_references = false>
   void PushMany(lua_State*);
@@ -143,6 +210,14 @@ namespace Lua{
 
   void PushCodeFile(lua_State* L, const char* filename);
   void PushCodeString(lua_State* L, const std::string& lua_code);
+
+  //! Loads Lua code of known length, without running it.
+  /*! The code may contain embedded null characters.
+    The chunkname is used in error messages, and follows the conventions of lua_load.
+    The mode is passed to lua_load, and by default accepts both text and precompiled code.
+   */
+  void PushCodeBuffer(lua_State* L, const char* buffer, size_t size, const char* chunkname,
+                      const char* mode = nullptr);
 }
 
 #include "LuaTableReference.hh"
@@ -154,58 +229,109 @@ void Lua::PushValueDirect(lua_State*, LuaTableReference<T> ref){
 }
 
 template<typename T>
-typename std::enable_if<std::is_arithmetic<T>::value>::type
+typename std::enable_if<std::is_integral<T>::value>::type
+Lua::PushValueDirect(lua_State* L, T t){
+  lua_pushinteger(L, static_cast<lua_Integer>(t));
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
 Lua::PushValueDirect(lua_State* L, T t){
   lua_pushnumber(L, t);
 }
 
+template<typename T>
+void Lua::PushValueDirect(lua_State* L, CheckedInteger<T> t){
+  PushValueDirect(L, t.value);
+}
+
 template<typename RetVal, typename... Params>
 void Lua::PushValueDirect(lua_State* L, std::function<RetVal(Params...)> func){
   LuaCallable* callable = new LuaCallable_CppFunction<RetVal(Params...)>(func);
   PushValueDirect(L, callable);
 }
 
-template<typename T>
-void Lua::PushValueDirect(lua_State* L, std::shared_ptr<T> t){
-  int metatable_exists = luaL_getmetatable(L, class_registry_entry<T>::get().c_str());
-  lua_pop(L, 1); // luaL_getmetatable pushes nil if no such table exists
-  if(!metatable_exists){
-    throw LuaClassNotRegistered("The class requested was not registered with the LuaState");
+template<typename Held, typename... Args>
+void Lua::PushHeldPointer(lua_State* L, Args&&... args){
+  // Lua only guarantees alignment suitable for the standard types.
+  // Over-allocate if needed, so that the object can be aligned within the userdata.
+  size_t space = sizeof(Held);
+  if(alignof(Held) > alignof(HeldPointer*)){
+    space += alignof(Held) - 1;
   }
-
-
-  // Allocate memory held by lua to store, construct into that location.
-  int memsize = sizeof(HeldPointer*) + sizeof(VariableSharedPointer<T>);
-  void* userdata = lua_newuserdata(L, memsize);
+  void* userdata = lua_newuserdata(L, sizeof(HeldPointer*) + space);
   void* storage = static_cast<void*>(static_cast<char*>(userdata) + sizeof(HeldPointer*));
-  VariableSharedPointer<T>* ptr = new(storage) VariableSharedPointer<T>(t);
+  std::align(alignof(Held), sizeof(Held), storage, space);
+
+  Held* ptr = nullptr;
+  try{
+    ptr = new(storage) Held(std::forward<Args>(args)...);
+  } catch(...) {
+    lua_pop(L, 2);
+    throw;
+  }
 
-  // Can't just store the VariableWeakPointer<T>*,
+  // Can't just store the Held*,
   //   because we need to be able to cast from void* to HeldPointer*.
   *static_cast<HeldPointer**>(userdata) = ptr;
 
-  luaL_setmetatable(L, class_registry_entry<T>::get().c_str());
+  // Stack is now [metatable, userdata].
+  lua_insert(L, -2);
+  lua_setmetatable(L, -2);
+}
+
+template<typename T, typename... Args>
+void Lua::PushValueInPlace(lua_State* L, Args&&... args){
+  // Grab the metatable first, so that nothing is constructed for an unregistered class.
+  PushClassMetatable<T>(L);
+  PushHeldPointer<VariableValue<T> >(L, std::forward<Args>(args)...);
 }
 
 template<typename T>
-void Lua::PushValueDirect(lua_State* L, std::weak_ptr<T> t){
-  int metatable_exists = luaL_getmetatable(L, class_registry_entry<T>::get().c_str());
-  lua_pop(L, 1); // luaL_getmetatable pushes nil if no such table exists
-  if(!metatable_exists){
-    throw LuaClassNotRegistered("The class requested was not registered with the LuaState");
+void Lua::PushValueDirect(lua_State* L, std::shared_ptr<T> t){
+  // If enabled, reuse the userdata from an earlier push of the same object.
+  const void* address = t.get();
+  if(PushCachedIdentity(L, IdentityCacheKind::SharedPointer, class_registry_entry<T>::get(), address)){
+    return;
   }
 
-  // Allocate memory held by lua to store, construct into that location.
-  int memsize = sizeof(HeldPointer*) + sizeof(VariableWeakPointer<T>);
-  void* userdata = lua_newuserdata(L, memsize);
-  void* storage = static_cast<void*>(static_cast<char*>(userdata) + sizeof(HeldPointer*));
-  VariableWeakPointer<T>* ptr = new(storage) VariableWeakPointer<T>(t);
+  // Grab the metatable first, so that nothing is constructed for an unregistered class.
+  PushClassMetatable<T>(L);
 
-  // Can't just store the VariableWeakPointer<T>*,
-  //   because we need to be able to cast from void* to HeldPointer*.
-  *static_cast<HeldPointer**>(userdata) = ptr;
+  typedef typename std::remove_const<T>::type NonConstT;
+  std::shared_ptr<void> shared = std::const_pointer_cast<NonConstT>(std::move(t));
+  PushHeldPointer<VariableSharedPointer>(L, std::move(shared));
 
-  luaL_setmetatable(L, class_registry_entry<T>::get().c_str());
+  CacheIdentity(L, IdentityCacheKind::SharedPointer, class_registry_entry<T>::get(), address);
+}
+
+template<typename T>
+void Lua::PushValueDirect(lua_State* L, std::weak_ptr<T> t){
+  // Grab the metatable first, so that nothing is constructed for an unregistered class.
+  PushClassMetatable<T>(L);
+
+  // The object pointed to never changes, so it can be stored now.
+  // If already expired, an empty weak_ptr is equivalent.
+  typedef typename std::remove_const<T>::type NonConstT;
+  std::shared_ptr<NonConstT> locked = std::const_pointer_cast<NonConstT>(t.lock());
+  std::weak_ptr<void> weak = locked;
+  PushHeldPointer<VariableWeakPointer>(L, std::move(weak), static_cast<void*>(locked.get()));
+}
+
+template<typename Ptr>
+typename std::enable_if<Lua::has_smart_pointer_traits<typename std::decay<Ptr>::type>::value>::type
+Lua::PushValueDirect(lua_State* L, Ptr&& ptr){
+  typedef typename std::decay<Ptr>::type PtrType;
+  typedef typename SmartPointerTraits<PtrType>::element_type T;
+
+  if(!SmartPointerTraits<PtrType>::get(ptr)){
+    lua_pushnil(L);
+    return;
+  }
+
+  // Grab the metatable first, so that nothing is constructed for an unregistered class.
+  PushClassMetatable<T>(L);
+  PushHeldPointer<VariableCustomPointer<PtrType> >(L, std::forward<Ptr>(ptr));
 }
 
 // LuaCallable (and subclasses) is the only thing that is currently pushed by pointer.
@@ -214,28 +340,26 @@ template<typename T>
 typename std::enable_if<!std::is_base_of<Lua::LuaCallable, T>::value &&
                         !std::is_base_of<Lua::Upcaster, T>::value>::type
 Lua::PushValueDirect(lua_State* L, T* t, bool track_reference){
-  int metatable_exists = luaL_getmetatable(L, class_registry_entry<T>::get().c_str());
-  lua_pop(L, 1); // luaL_getmetatable pushes nil if no such table exists
-  if(!metatable_exists){
-    throw LuaClassNotRegistered("The class requested was not registered with the LuaState");
+  // References are only valid for a single call, and so are never shared.
+  if(!track_reference &&
+     PushCachedIdentity(L, IdentityCacheKind::CPointer, class_registry_entry<T>::get(), t)){
+    return;
   }
 
-  unsigned long reference_id = 0;
+  // Grab the metatable first, so that nothing is constructed for an unregistered class.
+  PushClassMetatable<T>(L);
+
+  typedef typename std::remove_const<T>::type NonConstT;
+  void* raw = const_cast<NonConstT*>(t);
   if(track_reference) {
-    reference_id = GenerateReferenceID(L);
+    PushHeldPointer<VariableReference>(L, raw, GenerateReferenceID(L));
+  } else {
+    PushHeldPointer<VariableCPointer>(L, raw);
   }
 
-  // Allocate memory held by lua to store, construct into that location.
-  int memsize = sizeof(HeldPointer*) + sizeof(VariableCPointer<T>);
-  void* userdata = lua_newuserdata(L, memsize);
-  void* storage = static_cast<void*>(static_cast<char*>(userdata) + sizeof(HeldPointer*));
-  VariableCPointer<T>* ptr = new(storage) VariableCPointer<T>(t, reference_id);
-
-  // Can't just store the VariableWeakPointer<T>*,
-  //   because we need to be able to cast from void* to HeldPointer*.
-  *static_cast<HeldPointer**>(userdata) = ptr;
-
-  luaL_setmetatable(L, class_registry_entry<T>::get().c_str());
+  if(!track_reference){
+    CacheIdentity(L, IdentityCacheKind::CPointer, class_registry_entry<T>::get(), t);
+  }
 }
 
 template<typename RetVal, typename... Params>
@@ -243,47 +367,89 @@ void Lua::PushValueDirect(lua_State* L, RetVal (*func)(Params...)){
   PushValueDirect(L, std::function<RetVal(Params...)>(func));
 }
 
+template<typename T>
+void Lua::PushValueDirect(lua_State* L, Borrowed<T> borrowed){
+  PushValueDirect(L, borrowed.ptr, false);
+}
+
 template<int... Indices, typename... Params>
-void Lua::PushValueDirect_TupleHelper(lua_State* L, std::tuple<Params...> tuple, indices<Indices...>){
-  PushMany(L, std::get<Indices>(tuple)...);
+void Lua::PushValueDirect_TupleHelper(lua_State* L, std::tuple<Params...>&& tuple, indices<Indices...>){
+  // std::get of an rvalue tuple moves each value, but leaves reference members as references.
+  PushMany(L, std::get<Indices>(std::move(tuple))...);
 }
 
 template<typename... Params>
 void Lua::PushValueDirect(lua_State* L, std::tuple<Params...> tuple){
-  PushValueDirect_TupleHelper(L, tuple, build_indices<sizeof...(Params)>());
+  PushValueDirect_TupleHelper(L, std::move(tuple), build_indices<sizeof...(Params)>());
 }
 
+//! Pushes a std::vector<T> as a new table, with keys 1 through vec.size().
+/*! The table is pre-sized, and filled with raw sets,
+    so no rehashing or metamethod lookup occurs.
+ */
 template<typename T>
-void Lua::PushValueDirect(lua_State* L, std::vector<T> vec){
-  Lua::NewTable(L);
-  Lua::LuaObject table(L);
-  for(unsigned int i=0; i<vec.size(); i++){
-    table[i+1] = vec[i];
+void Lua::PushValueDirect(lua_State* L, const std::vector<T>& vec){
+  lua_createtable(L, static_cast<int>(vec.size()), 0);
+  lua_Integer i = 1;
+  for(const auto& value : vec){
+    Push(L, value);
+    lua_rawseti(L, -2, i++);
   }
 }
 
+//! Pushes a std::map<std::string, T> as a new table.
+/*! As with std::vector<T>, the table is pre-sized, and filled with raw sets.
+ */
 template<typename T>
-void Lua::PushValueDirect(lua_State* L, std::map<std::string, T> map){
-  Lua::NewTable(L);
-  Lua::LuaObject table(L);
-  for(auto iter : map){
-    table[iter.first] = iter.second;
+void Lua::PushValueDirect(lua_State* L, const std::map<std::string, T>& map){
+  lua_createtable(L, 0, static_cast<int>(map.size()));
+  for(const auto& iter : map){
+    Push(L, iter.first);
+    Push(L, iter.second);
+    lua_rawset(L, -3);
   }
 }
 
+namespace Lua{
+  template<typename T, typename... Fields, int... Indices>
+  void PushReflected_Helper(lua_State* L, const T& t, const std::tuple<Fields...>& fields,
+                            indices<Indices...>){
+    // Stack is [names, table].  Each field name is looked up by position.
+    int dummy[] = {0, (lua_rawgeti(L, -2, Indices+1),
+                       Push(L, t.*(std::get<Indices>(fields).member)),
+                       lua_rawset(L, -3),
+                       0)...};
+    (void)dummy;
+  }
+}
+
+//! Pushes a struct described by LUA_REFLECT as a new table, with one entry per field.
+/*! The table is pre-sized for the number of fields,
+    and the field names are taken from a table cached in the registry.
+ */
+template<typename T>
+typename std::enable_if<Lua::is_reflected<T>::value>::type
+Lua::PushValueDirect(lua_State* L, const T& t){
+  auto fields = ReflectedFields<T>();
+  const int num_fields = std::tuple_size<decltype(fields)>::value;
+
+  PushReflectedNames<T>(L);
+  lua_createtable(L, 0, num_fields);
+  PushReflected_Helper(L, t, fields, build_indices<num_fields>());
+  lua_remove(L, -2);
+}
+
 // Need separate specialization for l-value reference, r-value reference.
 // Otherwise, it will try to make a std::shared_ptr<T&>, which is nonsensical.
 template<typename T, bool track_references>
 void Lua::PushDefaultType<T, track_references>::Push(lua_State* L, T&& t){
-  auto obj = std::make_shared<T>(t);
-  PushValueDirect(L, obj);
+  PushValueInPlace<T>(L, std::move(t));
 }
 
 // And here is the case for l-value references.
 template<typename T, bool track_references>
 void Lua::PushDefaultType<T&, track_references>::Push(lua_State* L, T& t){
-  auto obj = std::make_shared<T>(t);
-  PushValueDirect(L, obj);
+  PushValueInPlace<T>(L, t);
 }
 
 template<typename T, bool track_references>
@@ -292,9 +458,9 @@ void Lua::PushDefaultType<std::reference_wrapper<T>, track_references>::Push(lua
 }
 
 template<bool track_references, typename T>
-auto Lua::PushDirectIfPossible(lua_State* L, T t, bool)
-  -> decltype(PushValueDirect(L, t)) {
-  PushValueDirect(L, t);
+auto Lua::PushDirectIfPossible(lua_State* L, T&& t, bool)
+  -> decltype(PushValueDirect(L, std::forward<T>(t))) {
+  PushValueDirect(L, std::forward<T>(t));
 }
 
 template<bool track_references, typename T>
@@ -325,5 +491,19 @@ void Lua::PushMany(lua_State* L, FirstParam&& first, Params&&... params){
   PushMany<track_references>(L, std::forward<Params>(params)...);
 }
 
+template<typename RetVal>
+int Lua::PushReturnValue<RetVal>::Push(lua_State* L, RetVal& output){
+  int top = lua_gettop(L);
+  Lua::Push(L, std::move(output));
+  return lua_gettop(L) - top;
+}
+
+template<typename T>
+int Lua::PushReturnValue<T&>::Push(lua_State* L, T& output){
+  int top = lua_gettop(L);
+  Lua::Push(L, std::ref(output));
+  return lua_gettop(L) - top;
+}
+
 
 #endif /* _LUAPUSH_H_ */
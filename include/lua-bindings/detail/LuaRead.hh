@@ -3,21 +3,29 @@
 
 #include <cassert>
 #include <functional>
+#include <limits>
 #include <map>
 #include <memory>
 #include <set>
 #include <tuple>
 #include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 #include <lua.hpp>
 
+#include "LuaCheckedInteger.hh"
 #include "LuaExceptions.hh"
 #include "LuaHoldWeakPtr.hh"
 #include "LuaObject.hh"
 #include "LuaPointerType.hh"
 #include "LuaPush.hh"
+#include "LuaReflect.hh"
 #include "LuaReferenceSet.hh"
 #include "LuaRegistryNames.hh"
+#include "LuaSmartPointer.hh"
+#include "LuaStringRef.hh"
 #include "LuaTableReference.hh"
 #include "TemplateUtils.hh"
 
@@ -28,10 +36,14 @@ namespace Lua{
       without any additional dispatch to methods.
    */
   template<typename T>
-  typename std::enable_if<std::is_arithmetic<T>::value &&
+  typename std::enable_if<std::is_integral<T>::value &&
                           !std::is_same<T, bool>::value, T>::type
     ReadDirect(lua_State* L, int index);
 
+  template<typename T>
+  typename std::enable_if<std::is_floating_point<T>::value, T>::type
+    ReadDirect(lua_State* L, int index);
+
   template<typename T>
   typename std::enable_if<std::is_same<T, std::string>::value, T>::type
     ReadDirect(lua_State* L, int index);
@@ -44,6 +56,14 @@ namespace Lua{
   typename std::enable_if<std::is_same<T, void*>::value, T>::type
     ReadDirect(lua_State* L, int index);
 
+  template<typename T>
+  typename std::enable_if<has_smart_pointer_traits<T>::value, T>::type
+    ReadDirect(lua_State* L, int index);
+
+  template<typename T>
+  typename std::enable_if<is_reflected<T>::value, T>::type
+    ReadDirect(lua_State* L, int index);
+
   //! Helper method, for grabbing a pointer from the stack.
   template<typename T>
     PointerAccess ReadHeldPointer(lua_State* L, int index);
@@ -118,6 +138,30 @@ namespace Lua{
     static std::function<RetVal(Params...)> Read(lua_State* L, int index);
   };
 
+  //! Read a string, without copying.
+  /*! Only valid while the value remains on the stack.
+   */
+  template<bool allow_references>
+  struct ReadDefaultType<StringRef, allow_references >{
+    static StringRef Read(lua_State* L, int index);
+  };
+
+#if __cplusplus >= 201703L
+  //! Read a string, without copying.
+  /*! Only valid while the value remains on the stack.
+   */
+  template<bool allow_references>
+  struct ReadDefaultType<std::string_view, allow_references >{
+    static std::string_view Read(lua_State* L, int index);
+  };
+#endif
+
+  //! Read as an integer, throwing if the value is not an integer or is out of range.
+  template<typename T, bool allow_references>
+  struct ReadDefaultType<CheckedInteger<T>, allow_references >{
+    static CheckedInteger<T> Read(lua_State* L, int index);
+  };
+
   template<typename T, bool allow_references>
     T ReadDirectIfPossible(lua_State* L, int index, int);
 
@@ -149,8 +193,25 @@ namespace Lua{
       without any additional dispatch to methods.
    */
   template<typename T>
-  typename std::enable_if<std::is_arithmetic<T>::value &&
+  typename std::enable_if<std::is_integral<T>::value &&
                           !std::is_same<T, bool>::value, T>::type
+  ReadDirect(lua_State* L, int index){
+    int success;
+    lua_Integer output = lua_tointegerx(L, index, &success);
+    if(success){
+      return static_cast<T>(output);
+    }
+
+    // Not representable as an integer, such as 1.5, so truncate.
+    lua_Number number = lua_tonumberx(L, index, &success);
+    if(!success){
+      throw LuaInvalidStackContents("Lua value could not be converted to number");
+    }
+    return static_cast<T>(number);
+  }
+
+  template<typename T>
+  typename std::enable_if<std::is_floating_point<T>::value, T>::type
   ReadDirect(lua_State* L, int index){
     int success;
     lua_Number output = lua_tonumberx(L, index, &success);
@@ -163,8 +224,10 @@ namespace Lua{
   template<typename T>
   typename std::enable_if<std::is_same<T, std::string>::value, T>::type
   ReadDirect(lua_State* L, int index){
-    if(lua_isstring(L, index)){
-      return lua_tostring(L, index);
+    size_t len;
+    const char* str = lua_tolstring(L, index, &len);
+    if(str){
+      return std::string(str, len);
     } else {
       throw LuaInvalidStackContents("Lua value could not be converted to string");
     }
@@ -182,68 +245,113 @@ namespace Lua{
     return lua_touserdata(L, index);
   }
 
-  //! Helper method, for grabbing a pointer from the stack.
+  //! Reads a user-defined smart pointer, as described by SmartPointerTraits.
+  /*! Only objects pushed as the same kind of smart pointer can be read,
+        possibly pointing to a derived class.
+      Nil is read as a null pointer.
+
+    @throws LuaIncorrectPointerType The object is held by value,
+        or by any other kind of pointer.
+   */
   template<typename T>
-  PointerAccess ReadHeldPointer(lua_State* L, int index){
-    void* storage = lua_touserdata(L, index);
+  typename std::enable_if<has_smart_pointer_traits<T>::value, T>::type
+  ReadDirect(lua_State* L, int index){
+    typedef typename SmartPointerTraits<T>::element_type Element;
 
-    if(!storage){
-      throw LuaInvalidStackContents("Value was not userdata");
+    if(lua_isnil(L, index)){
+      return SmartPointerTraits<T>::from_raw(nullptr);
+    }
+
+    auto ptr = ReadHeldPointer<Element>(L, index);
+    if(ptr.GetKind() == HeldPointer::Kind::Value){
+      throw LuaIncorrectPointerType("Cannot convert object held by value to smart pointer");
+    } else if(ptr.GetKind() != HeldPointer::Kind::Custom ||
+              ptr.GetCustomType() != smart_pointer_type<T>::id()){
+      throw LuaIncorrectPointerType("Cannot convert object held by a different pointer type to smart pointer");
     }
+    return SmartPointerTraits<T>::from_raw(static_cast<Element*>(ptr.get_c(L)));
+  }
 
-    // Grab the correct metatables out of the registry.
-    LuaObject registry(L, LUA_REGISTRYINDEX);
-    LuaObject class_metatable = registry[class_registry_entry<T>::get()].Get();
-    LuaObject class_metatable_nonconst = registry[class_registry_entry<T,true>::get()].Get();
+  //! Reads one field of a struct described by LUA_REFLECT.
+  /*! The table is at "index", and the names of the fields are on top of the stack.
+    A field that is nil in the table is left unchanged.
+   */
+  template<typename T, typename Class, typename Member>
+  void ReadReflectedField(lua_State* L, int index, T& output,
+                          const ReflectedField<Class, Member>& field, int position){
+    lua_rawgeti(L, -1, position);
+    LuaDelayedPop delay(L, 1);
+    if(lua_rawget(L, index) != LUA_TNIL){
+      output.*(field.member) = Read<Member, false>(L, -1);
+    }
+  }
 
-    // Grab the class index.  We will compare against these.
-    LuaObject class_index = class_metatable["__index"].Get();
-    LuaObject class_index_nonconst = class_metatable_nonconst["__index"].Get();
-    LuaDelayedPop delay(L, 4);
+  template<typename T, typename... Fields, int... Indices>
+  void ReadReflected_Helper(lua_State* L, int index, T& output,
+                            const std::tuple<Fields...>& fields, indices<Indices...>){
+    int dummy[] = {0, (ReadReflectedField(L, index, output, std::get<Indices>(fields), Indices+1), 0)...};
+    (void)dummy;
+  }
 
-    bool is_correct_class = false;
-    int curr_index = index;
+  //! Reads a struct described by LUA_REFLECT from a table.
+  /*! The struct is value-initialized, and then each field present in the table is read.
+    Fields missing from the table keep their default values.
 
-    std::vector<Upcaster*> upcasters;
+    @throws LuaInvalidStackContents The value is not a table,
+        or one of the fields cannot be converted.
+   */
+  template<typename T>
+  typename std::enable_if<is_reflected<T>::value, T>::type
+  ReadDirect(lua_State* L, int index){
+    index = lua_absindex(L, index);
+    if(!lua_istable(L, index)){
+      throw LuaInvalidStackContents("Lua value was not a table");
+    }
 
-    while(!is_correct_class) {
-      bool has_metatable = lua_getmetatable(L, curr_index);
-      if(!has_metatable){
-        break;
-      }
-      delay.SetNumPop(delay.GetNumPop() + 1);
-      LuaObject obj_metatable(L, -1);
+    auto fields = ReflectedFields<T>();
+    const int num_fields = std::tuple_size<decltype(fields)>::value;
 
-      LuaObject obj_index = obj_metatable["__index"].Get();
-      delay.SetNumPop(delay.GetNumPop() + 1);
+    T output{};
+    PushReflectedNames<T>(L);
+    LuaDelayedPop delay(L, 1);
+    ReadReflected_Helper(L, index, output, fields, build_indices<num_fields>());
+    return output;
+  }
 
-      is_correct_class = obj_index == class_index;
+  //! Helper method, for grabbing a pointer from the stack.
+  /*! The upcasters needed to convert from the class of the object to T
+      are cached in the metatable of the object, keyed by the registry key of T.
+    After the first read of a given class as T, this is a single table lookup.
+   */
+  template<typename T>
+  PointerAccess ReadHeldPointer(lua_State* L, int index){
+    void* storage = lua_touserdata(L, index);
 
-      // If 'const' is requested, can also return a non-const version.
-      // This will not, however, cause the non-const request to return a const version.
-      // The std::is_same check is not required, but allows this conditional
-      //   to be optimized out when requesting a non-const member.
-      if(!std::is_same<T, typename std::remove_const<T>::type>::value &&
-         !is_correct_class){
-        is_correct_class = obj_index == class_index_nonconst;
-      }
+    if(!storage){
+      throw LuaInvalidStackContents("Value was not userdata");
+    }
 
-      if(!is_correct_class) {
-        if(obj_metatable["upcaster"].Exists()) {
-          void* upcaster = obj_metatable["upcaster"].Cast<void*>();
-          upcasters.push_back(*static_cast<Upcaster**>(upcaster));
-        }
-      }
+    if(!lua_getmetatable(L, index)){
+      throw LuaInvalidStackContents("Value could not be converted to requested type.");
+    }
+    LuaDelayedPop delay(L, 2);
 
-      curr_index = obj_index.StackPos();
+    int cached = lua_rawgetp(L, -1, class_registry_entry<T>::get());
+    if(cached == LUA_TNIL){
+      lua_pop(L, 1);
+      PushUpcastChain(L, class_registry_entry<T>::get(), class_registry_entry<T,true>::get());
     }
 
-    if(!is_correct_class){
+    if(lua_type(L, -1) != LUA_TUSERDATA){
       throw LuaInvalidStackContents("Value could not be converted to requested type.");
     }
 
+    // The chain is held by the metatable, and so outlives this stack slot.
+    Upcaster** upcasters = static_cast<Upcaster**>(lua_touserdata(L, -1));
+    size_t num_upcasters = lua_rawlen(L, -1) / sizeof(Upcaster*);
+
     HeldPointer* held = *static_cast<HeldPointer**>(storage);
-    return PointerAccess(held, upcasters);
+    return PointerAccess(held, upcasters, num_upcasters);
   }
 
   //! Read from the stack, by value.
@@ -336,12 +444,17 @@ namespace Lua{
     LuaDelayedPop delay(L, 1);
     while(lua_next(L, index) ){
       LuaDelayedPop delay(L, 1);
-      std::string key = Lua::Read<std::string>(L, -2);
-      T value = Lua::Read<T>(L, -1);
-      output[key] = value;
-      lua_pop(L, 2); // Reading a string may modify its contents.  Therefore, replacing it.
-      delay.SetNumPop(0);
-      Lua::Push(L, key);
+      // Converting a number to a string modifies the stack slot, which would confuse lua_next.
+      // Only string keys, the expected case, are read in place.
+      std::string key;
+      if(lua_type(L, -2) == LUA_TSTRING){
+        key = Lua::Read<std::string>(L, -2);
+      } else {
+        lua_pushvalue(L, -2);
+        LuaDelayedPop delay_key(L, 1);
+        key = Lua::Read<std::string>(L, -1);
+      }
+      output[key] = Lua::Read<T>(L, -1);
     }
     // The last call of lua_next pushes nothing to the stack.
     // We needed the safe-guard as any of the Lua::Read calls could throw,
@@ -355,9 +468,8 @@ namespace Lua{
   ::Read(lua_State* L, int index){
     // If the value is a std::function previously exposed by C++,
     //   return it directly.
-    void* as_userdata = lua_touserdata(L, index);
-    if(as_userdata){
-      Lua::LuaCallable* callable = *static_cast<Lua::LuaCallable**>(as_userdata);
+    Lua::LuaCallable* callable = GetLuaCallable(L, index);
+    if(callable){
       auto callable_cppfunction = dynamic_cast<LuaCallable_CppFunction<RetVal(Params...)>* >(callable);
       if(callable_cppfunction){
         return callable_cppfunction->GetFunc();
@@ -371,6 +483,57 @@ namespace Lua{
     };
   }
 
+  //! Read as an integer, throwing if the value is not an integer or is out of range.
+  template<typename T, bool allow_references>
+  CheckedInteger<T> ReadDefaultType<CheckedInteger<T>, allow_references >
+  ::Read(lua_State* L, int index){
+    int success;
+    lua_Integer output = lua_tointegerx(L, index, &success);
+    if(!success){
+      throw LuaIntegerConversionError("Lua value could not be converted to integer");
+    }
+
+    bool in_range;
+    if(std::is_signed<T>::value){
+      in_range = (output >= static_cast<lua_Integer>(std::numeric_limits<T>::min()) &&
+                  output <= static_cast<lua_Integer>(std::numeric_limits<T>::max()));
+    } else if(sizeof(T) >= sizeof(lua_Integer)){
+      // Values above the maximum lua_Integer are pushed as their two's-complement bit pattern,
+      //   so every lua_Integer is the representation of some value of T.
+      in_range = true;
+    } else {
+      // Compare as unsigned, since the maximum of T may not fit in a lua_Integer.
+      in_range = (output >= 0 &&
+                  static_cast<unsigned long long>(output) <=
+                  static_cast<unsigned long long>(std::numeric_limits<T>::max()));
+    }
+
+    if(!in_range){
+      throw LuaIntegerConversionError("Lua integer out of range of requested type");
+    }
+    return CheckedInteger<T>(static_cast<T>(output));
+  }
+
+  template<bool allow_references>
+  StringRef ReadDefaultType<StringRef, allow_references >::Read(lua_State* L, int index){
+    static_assert(allow_references, "Unsafe to read as a StringRef here");
+    size_t len;
+    const char* str = lua_tolstring(L, index, &len);
+    if(!str){
+      throw LuaInvalidStackContents("Lua value could not be converted to string");
+    }
+    return StringRef(str, len);
+  }
+
+#if __cplusplus >= 201703L
+  template<bool allow_references>
+  std::string_view ReadDefaultType<std::string_view, allow_references >::Read(lua_State* L, int index){
+    static_assert(allow_references, "Unsafe to read as a std::string_view here");
+    StringRef str = ReadDefaultType<StringRef, allow_references>::Read(L, index);
+    return std::string_view(str.data(), str.size());
+  }
+#endif
+
   template<typename T, bool allow_references>
   T ReadDirectIfPossible(lua_State* L, int index, int){
     return ReadDefaultType<T, allow_references>::Read(L, index);
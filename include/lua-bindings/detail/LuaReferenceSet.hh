@@ -1,22 +1,61 @@
 #ifndef _LUAREFERENCESET_H_
 #define _LUAREFERENCESET_H_
 
-#include <set>
+#include <cstddef>
 
 struct lua_State;
 
 namespace Lua{
+  //! Identifies a C++ reference passed into Lua, and the call during which it is valid.
+  /*! A call_id of 0 indicates an untracked reference, which is always valid.
+   */
+  struct ReferenceID{
+    ReferenceID() : depth(0), call_id(0) { }
+    ReferenceID(size_t depth, unsigned long call_id)
+      : depth(depth), call_id(call_id) { }
+
+    size_t depth;
+    unsigned long call_id;
+  };
+
   void InitializeValidReferenceTable(lua_State* L);
-  unsigned long GenerateReferenceID(lua_State* L);
-  bool IsValidReference(lua_State* L, unsigned long reference_id);
 
+  //! Returns a new ReferenceID, valid until the innermost PreserveValidReferences ends.
+  ReferenceID GenerateReferenceID(lua_State* L);
+
+  //! Returns whether the reference is still valid.
+  /*! Each call from C++ into Lua is given a unique id, stored at its call depth.
+    A reference is valid if the call it was made in is still at that depth.
+    This is constant time, regardless of the number of references made.
+   */
+  bool IsValidReference(lua_State* L, ReferenceID reference_id);
+
+  //! Marks the duration of a call from C++ into Lua.
+  /*! Any reference generated while this is the innermost call
+      becomes invalid once it is destructed.
+   */
   class PreserveValidReferences{
   public:
     PreserveValidReferences(lua_State* L);
     ~PreserveValidReferences();
   private:
     lua_State* L;
-    std::set<unsigned long> saved_values;
+  };
+
+  //! A PreserveValidReferences, if enabled.
+  /*! Used when it is known at compile time whether any references will be made.
+   */
+  template<bool enabled>
+  class MaybePreserveValidReferences : public PreserveValidReferences{
+  public:
+    MaybePreserveValidReferences(lua_State* L)
+      : PreserveValidReferences(L) { }
+  };
+
+  template<>
+  class MaybePreserveValidReferences<false>{
+  public:
+    MaybePreserveValidReferences(lua_State*) { }
   };
 }
 
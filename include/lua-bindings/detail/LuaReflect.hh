@@ -0,0 +1,141 @@
+#ifndef _LUAREFLECT_H_
+#define _LUAREFLECT_H_
+
+#include <tuple>
+#include <type_traits>
+
+#include <lua.hpp>
+
+#include "LuaRegistryNames.hh"
+#include "TemplateUtils.hh"
+
+//! Describes the fields of a struct, so that it is converted to and from a Lua table.
+/*! Must be used in the same namespace as the struct.
+  Up to 32 fields can be listed.
+
+  Usage:
+    struct Event{
+      int id;
+      double time;
+      std::string name;
+    };
+    LUA_REFLECT(Event, id, time, name);
+
+  Pushing an Event then makes a table {id=..., time=..., name=...},
+    and reading an Event reads each field from a table.
+ */
+#define LUA_REFLECT(Struct, ...)                                        \
+  inline auto lua_reflect_fields(const Struct*) {                       \
+    return std::make_tuple(LUA_REFLECT_CONCAT(LUA_REFLECT_FIELDS_, LUA_REFLECT_NARGS(__VA_ARGS__)) \
+                           (Struct, __VA_ARGS__));                      \
+  }                                                                     \
+  static_assert(std::is_class<Struct>::value, "LUA_REFLECT requires a class type")
+
+#define LUA_REFLECT_FIELD(Struct, field) ::Lua::reflect_field(#field, &Struct::field)
+
+#define LUA_REFLECT_CONCAT(a, b) LUA_REFLECT_CONCAT_IMPL(a, b)
+#define LUA_REFLECT_CONCAT_IMPL(a, b) a##b
+
+// The trailing 0 ensures that the variadic argument is never empty, as required before C++20.
+#define LUA_REFLECT_NARGS(...) LUA_REFLECT_NARGS_IMPL(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LUA_REFLECT_NARGS_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+
+#define LUA_REFLECT_FIELDS_1(Struct, field) LUA_REFLECT_FIELD(Struct, field)
+#define LUA_REFLECT_FIELDS_2(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_1(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_3(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_2(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_4(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_3(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_5(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_4(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_6(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_5(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_7(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_6(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_8(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_7(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_9(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_8(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_10(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_9(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_11(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_10(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_12(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_11(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_13(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_12(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_14(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_13(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_15(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_14(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_16(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_15(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_17(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_16(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_18(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_17(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_19(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_18(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_20(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_19(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_21(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_20(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_22(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_21(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_23(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_22(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_24(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_23(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_25(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_24(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_26(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_25(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_27(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_26(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_28(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_27(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_29(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_28(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_30(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_29(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_31(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_30(Struct, __VA_ARGS__)
+#define LUA_REFLECT_FIELDS_32(Struct, field, ...) LUA_REFLECT_FIELD(Struct, field), LUA_REFLECT_FIELDS_31(Struct, __VA_ARGS__)
+
+namespace Lua{
+  //! A single field of a struct described by LUA_REFLECT.
+  template<typename Class, typename Member>
+  struct ReflectedField{
+    const char* name;
+    Member Class::* member;
+  };
+
+  template<typename Class, typename Member>
+  constexpr ReflectedField<Class, Member> reflect_field(const char* name, Member Class::* member){
+    return {name, member};
+  }
+
+  //! Whether LUA_REFLECT has been used for T.
+  /*! lua_reflect_fields is found by argument-dependent lookup,
+        which is why LUA_REFLECT must be in the same namespace as the struct.
+   */
+  template<typename T, typename = void>
+  struct is_reflected : std::false_type { };
+
+  template<typename T>
+  struct is_reflected<T, decltype(void(lua_reflect_fields(static_cast<const T*>(nullptr))))>
+    : std::true_type { };
+
+  //! Returns the fields of T, as a tuple of ReflectedField.
+  template<typename T>
+  auto ReflectedFields() -> decltype(lua_reflect_fields(static_cast<const T*>(nullptr))) {
+    return lua_reflect_fields(static_cast<const T*>(nullptr));
+  }
+
+  //! Tag type, whose type_holder gives the registry key of the field names of T.
+  template<typename T>
+  struct reflected_names_key { };
+
+  template<typename... Fields, int... Indices>
+  void PushReflectedNames_Helper(lua_State* L, const std::tuple<Fields...>& fields, indices<Indices...>){
+    int dummy[] = {0, (lua_pushstring(L, std::get<Indices>(fields).name),
+                       lua_rawseti(L, -2, Indices+1),
+                       0)...};
+    (void)dummy;
+  }
+
+  //! Pushes a table holding the name of each field of T, in order.
+  /*! The table is made once per lua_State, and kept in the registry.
+    Each conversion then looks up the field names by position,
+      rather than creating and hashing each string again.
+   */
+  template<typename T>
+  void PushReflectedNames(lua_State* L){
+    void* key = &type_holder<reflected_names_key<T> >::id;
+    if(lua_rawgetp(L, LUA_REGISTRYINDEX, key) == LUA_TTABLE){
+      return;
+    }
+    lua_pop(L, 1);
+
+    auto fields = ReflectedFields<T>();
+    const int num_fields = std::tuple_size<decltype(fields)>::value;
+    lua_createtable(L, num_fields, 0);
+    PushReflectedNames_Helper(L, fields, build_indices<num_fields>());
+
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, key);
+  }
+}
+
+#endif /* _LUAREFLECT_H_ */
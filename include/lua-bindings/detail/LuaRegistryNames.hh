@@ -1,50 +1,80 @@
 #ifndef _LUAREGISTRYNAMES_H_
 #define _LUAREGISTRYNAMES_H_
 
-#include <sstream>
 #include <string>
+#include <type_traits>
+
+#include <lua.hpp>
+
+#include "LuaExceptions.hh"
 
 namespace Lua {
   extern const std::string cpp_function_registry_entry;
 
   extern const std::string upcaster_registry_entry;
 
-  extern const std::string cpp_reference_counter;
-  extern const std::string cpp_valid_reference_set;
-  extern const std::string cpp_reference_set_metatable;
+  extern const std::string cpp_reference_frames;
+  extern const std::string cpp_reference_frames_metatable;
+
+  extern const std::string cpp_shared_identity_cache;
+  extern const std::string cpp_cpointer_identity_cache;
 
   extern const std::string keepalive_table;
 
   extern const std::string luastate_weakptr;
   extern const std::string luastate_weakptr_metatable;
 
+  //! Holds a unique address for each type.
+  /*! The address of type_holder<T>::id is used as a light userdata key in the registry.
+    This is a data member, rather than a function,
+      so that identical code folding can never give two types the same key.
+   */
   template<typename T>
-  struct type_holder{ static void id(){ } };
+  struct type_holder{ static char id; };
 
   template<typename T>
-  constexpr size_t type_id_safe(){
-    return reinterpret_cast<size_t>(&type_holder<T>::id);
-  }
+  char type_holder<T>::id = 0;
 
+  //! Returns the registry key of the metatable for class T.
+  /*! The key is a light userdata, used with lua_rawgetp/lua_rawsetp.
+    No string needs to be built or hashed to look up a class.
+   */
   template<typename T, bool nonconst=false>
   struct class_registry_entry{
-    static std::string get(){
-      std::stringstream ss;
+    static void* get(){
       if(nonconst){
-        ss << "Lua.Class." << type_id_safe<typename std::remove_const<T>::type>();
+        return &type_holder<typename std::remove_const<T>::type>::id;
       } else {
-        ss << "Lua.Class." << type_id_safe<T>();
+        return &type_holder<T>::id;
       }
-      return ss.str();
     }
   };
 
   template<typename T, bool nonconst>
   struct class_registry_entry<T&, nonconst>{
-    static std::string get(){
+    static void* get(){
       return class_registry_entry<T,nonconst>::get();
     }
   };
+
+  //! Pushes the metatable of class T onto the stack.
+  /*! Returns the type of the value pushed, which is LUA_TNIL if T has not been registered.
+   */
+  template<typename T, bool nonconst=false>
+  int GetClassMetatable(lua_State* L){
+    return lua_rawgetp(L, LUA_REGISTRYINDEX, class_registry_entry<T,nonconst>::get());
+  }
+
+  //! Pushes the metatable of class T onto the stack.
+  /*! @throws LuaClassNotRegistered T has not been registered with the lua_State.
+   */
+  template<typename T>
+  void PushClassMetatable(lua_State* L){
+    if(GetClassMetatable<T>(L) == LUA_TNIL){
+      lua_pop(L, 1);
+      throw LuaClassNotRegistered("The class requested was not registered with the LuaState");
+    }
+  }
 }
 
 #endif /* _LUAREGISTRYNAMES_H_ */
@@ -0,0 +1,80 @@
+#ifndef _LUASMARTPOINTER_H_
+#define _LUASMARTPOINTER_H_
+
+#include <type_traits>
+#include <utility>
+
+#include "LuaPointerType.hh"
+#include "LuaRegistryNames.hh"
+
+namespace Lua{
+  //! Customization point, allowing a user-defined smart pointer to be held by Lua.
+  /*! Specialize this for a smart pointer type to be able to push and read it.
+    The specialization must provide:
+      element_type, the class being pointed to, which must be registered with MakeClass.
+      static element_type* get(const Ptr& ptr), returning the object pointed to.
+      static Ptr from_raw(element_type* ptr), making a new smart pointer to an existing object.
+
+    from_raw is used when reading, and so this is only suitable for smart pointers
+      that can safely be made from a raw pointer, such as intrusive reference counts.
+
+    Usage:
+      template<typename T>
+      struct Lua::SmartPointerTraits<RefPtr<T> > {
+        typedef T element_type;
+        static T* get(const RefPtr<T>& ptr) { return ptr.get(); }
+        static RefPtr<T> from_raw(T* ptr) { return RefPtr<T>(ptr); }
+      };
+   */
+  template<typename Ptr>
+  struct SmartPointerTraits { };
+
+  //! Whether SmartPointerTraits has been specialized for Ptr.
+  template<typename Ptr, typename = void>
+  struct has_smart_pointer_traits : std::false_type { };
+
+  template<typename Ptr>
+  struct has_smart_pointer_traits<Ptr, decltype(void(sizeof(typename SmartPointerTraits<Ptr>::element_type)))>
+    : std::true_type { };
+
+  //! Tag type, naming a smart pointer template.
+  template<template<typename...> class Ptr>
+  struct smart_pointer_template { };
+
+  //! Identifies the kind of smart pointer, ignoring the class pointed to.
+  /*! Smart pointers made from the same template share an id,
+      so that a pointer to a derived class can be read as a pointer to its base class.
+   */
+  template<typename Ptr>
+  struct smart_pointer_type {
+    static const void* id() { return &type_holder<Ptr>::id; }
+  };
+
+  template<template<typename...> class Ptr, typename... Args>
+  struct smart_pointer_type<Ptr<Args...> > {
+    static const void* id() { return &type_holder<smart_pointer_template<Ptr> >::id; }
+  };
+
+  //! A user-defined smart pointer being held by the lua_State.
+  /*! The smart pointer is stored directly in the userdata, and released by __gc.
+   */
+  template<typename Ptr>
+  class VariableCustomPointer : public HeldCustomPointer {
+  public:
+    VariableCustomPointer(Ptr ptr)
+      : HeldCustomPointer(&VariableCustomPointer::destroy_pointer, smart_pointer_type<Ptr>::id()),
+        ptr(std::move(ptr)) {
+      typedef typename std::remove_const<typename SmartPointerTraits<Ptr>::element_type>::type NonConstT;
+      raw = const_cast<NonConstT*>(SmartPointerTraits<Ptr>::get(this->ptr));
+    }
+
+  private:
+    static void destroy_pointer(HeldPointer* held) {
+      static_cast<VariableCustomPointer*>(held)->~VariableCustomPointer();
+    }
+
+    Ptr ptr;
+  };
+}
+
+#endif /* _LUASMARTPOINTER_H_ */
@@ -0,0 +1,49 @@
+#ifndef _LUASTRINGREF_H_
+#define _LUASTRINGREF_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace Lua{
+  //! A string held by Lua, read without copying.
+  /*! Holds a pointer to the string's contents, and its length.
+    The contents may contain embedded null characters, and are not owned by the StringRef.
+    They remain valid as long as the Lua value is on the stack,
+      such as for the duration of a call into C++.
+    Therefore, reading a StringRef is only allowed for arguments of C++ functions called from Lua.
+
+    Usage:
+      int scan(Lua::StringRef payload);
+      L.SetGlobal("scan", Lua::Bind<decltype(&scan), &scan>());
+   */
+  class StringRef{
+  public:
+    StringRef() : ptr(nullptr), len(0) { }
+    StringRef(const char* ptr, size_t len) : ptr(ptr), len(len) { }
+    StringRef(const char* ptr) : ptr(ptr), len(std::strlen(ptr)) { }
+    StringRef(const std::string& str) : ptr(str.data()), len(str.size()) { }
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+    char operator[](size_t i) const { return ptr[i]; }
+
+    //! Copies the contents into a std::string.
+    std::string str() const { return std::string(ptr, len); }
+
+    bool operator==(const StringRef& other) const {
+      return len == other.len && (len == 0 || std::memcmp(ptr, other.ptr, len) == 0);
+    }
+    bool operator!=(const StringRef& other) const { return !(*this == other); }
+
+  private:
+    const char* ptr;
+    size_t len;
+  };
+}
+
+#endif /* _LUASTRINGREF_H_ */
@@ -0,0 +1,157 @@
+#ifndef _LUATABLEVIEW_H_
+#define _LUATABLEVIEW_H_
+
+#include <cstddef>
+#include <iterator>
+#include <string>
+
+#include <lua.hpp>
+
+#include "LuaDelayedPop.hh"
+#include "LuaExceptions.hh"
+#include "LuaRead.hh"
+
+namespace Lua{
+  template<typename T>
+  class TableValues;
+
+  //! A Lua table, read on demand rather than copied.
+  /*! Reading a std::vector<T> or std::map<std::string, T> converts every entry before the call.
+    A TableView instead refers to the table on the stack,
+      and converts only the entries that are accessed.
+    As with StringRef, the table is only guaranteed to stay on the stack
+      for the duration of a call into C++,
+      and so a TableView may only be used as an argument of C++ functions called from Lua.
+
+    All accesses are raw, and do not call metamethods.
+
+    Usage:
+      double total_mass(Lua::TableView particles){
+        double total = 0;
+        for(double mass : particles.Values<double>()){
+          total += mass;
+        }
+        return total;
+      }
+   */
+  class TableView{
+  public:
+    TableView(lua_State* L, int index)
+      : L(L), index(lua_absindex(L, index)) { }
+
+    //! The length of the array part of the table, as given by the # operator.
+    size_t Length() const {
+      return lua_rawlen(L, index);
+    }
+
+    //! Reads table[i+1], the i-th element of the array part, counting from zero.
+    /*! @throws LuaTableIndexOutOfRange i is not less than Length().
+      @throws LuaInvalidStackContents The element cannot be converted to T.
+     */
+    template<typename T>
+    T At(size_t i) const {
+      if(i >= Length()){
+        throw LuaTableIndexOutOfRange("Index " + std::to_string(i) + " out of range for table of length " +
+                                      std::to_string(Length()));
+      }
+      lua_rawgeti(L, index, i+1);
+      LuaDelayedPop delay(L, 1);
+      return Read<T, false>(L, -1);
+    }
+
+    //! Reads table[key].
+    /*! @throws LuaInvalidStackContents The value cannot be converted to T,
+          including when the key is not present and T cannot be read from nil.
+     */
+    template<typename T>
+    T Get(const std::string& key) const {
+      lua_pushlstring(L, key.data(), key.size());
+      lua_rawget(L, index);
+      LuaDelayedPop delay(L, 1);
+      return Read<T, false>(L, -1);
+    }
+
+    //! Returns whether table[key] is not nil.
+    bool Has(const std::string& key) const {
+      lua_pushlstring(L, key.data(), key.size());
+      bool output = lua_rawget(L, index) != LUA_TNIL;
+      lua_pop(L, 1);
+      return output;
+    }
+
+    //! A range over the array part of the table, converting each element to T when accessed.
+    template<typename T>
+    TableValues<T> Values() const {
+      return TableValues<T>(L, index, Length());
+    }
+
+  private:
+    lua_State* L;
+    int index;
+  };
+
+  //! The elements of the array part of a table, as returned by TableView::Values<T>().
+  /*! The length is read once, when the range is made.
+   */
+  template<typename T>
+  class TableValues{
+  public:
+    class iterator{
+    public:
+      typedef std::input_iterator_tag iterator_category;
+      typedef T value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const T* pointer;
+      typedef T reference;
+
+      iterator(lua_State* L, int index, size_t pos)
+        : L(L), index(index), pos(pos) { }
+
+      T operator*() const {
+        lua_rawgeti(L, index, pos+1);
+        LuaDelayedPop delay(L, 1);
+        return Read<T, false>(L, -1);
+      }
+
+      iterator& operator++() { pos++; return *this; }
+      iterator operator++(int) { iterator output = *this; pos++; return output; }
+
+      bool operator==(const iterator& other) const { return pos == other.pos; }
+      bool operator!=(const iterator& other) const { return pos != other.pos; }
+
+    private:
+      lua_State* L;
+      int index;
+      size_t pos;
+    };
+
+    TableValues(lua_State* L, int index, size_t length)
+      : L(L), index(index), length(length) { }
+
+    iterator begin() const { return iterator(L, index, 0); }
+    iterator end() const { return iterator(L, index, length); }
+    size_t size() const { return length; }
+
+  private:
+    lua_State* L;
+    int index;
+    size_t length;
+  };
+
+  //! Read a table, without copying.
+  /*! Only valid while the table remains on the stack.
+      @throws LuaInvalidStackContents The value is not a table.
+   */
+  template<bool allow_references>
+  struct ReadDefaultType<TableView, allow_references>{
+    static TableView Read(lua_State* L, int index){
+      static_assert(allow_references, "Unsafe to read as a Lua::TableView here");
+      if(!lua_istable(L, index)){
+        throw LuaInvalidStackContents("Lua value was not a table");
+      }
+      return TableView(L, index);
+    }
+  };
+}
+
+#endif /* _LUATABLEVIEW_H_ */
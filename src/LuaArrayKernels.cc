@@ -0,0 +1,213 @@
+#include "lua-bindings/detail/LuaArrayKernels.hh"
+
+// Compile each kernel for AVX2 as well as the baseline instruction set.
+// The dynamic loader picks the version to use, based on the CPU.
+// This requires ifunc support, so is limited to gcc on x86-64 linux.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__linux__) && defined(__x86_64__)
+#define LUA_ARRAY_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define LUA_ARRAY_KERNEL
+#endif
+
+namespace {
+  // Number of independent partial results kept by the reductions.
+  // Floating point addition is not associative, so the compiler may not
+  //   vectorize a loop that accumulates into a single value.
+  // Keeping several partial results makes the reordering explicit.
+  const size_t lanes = 8;
+
+  // The type used for elementwise arithmetic.
+  // Integers are computed as unsigned, at least as wide as an int,
+  //   so that overflow wraps around rather than being undefined.
+  template<typename T, bool = std::is_integral<T>::value>
+  struct arithmetic_type{
+    using type = T;
+  };
+
+  template<typename T>
+  struct arithmetic_type<T, true>{
+    using type = typename std::common_type<typename std::make_unsigned<T>::type,
+                                           unsigned int>::type;
+  };
+
+  // The type used to accumulate sums, before converting to array_accumulator.
+  template<typename T, bool = std::is_integral<T>::value>
+  struct sum_type{
+    using type = Lua::array_accumulator<T>;
+  };
+
+  template<typename T>
+  struct sum_type<T, true>{
+    using type = unsigned long long;
+  };
+
+  template<typename T>
+  inline T wrapping_multiply(T a, T b){
+    using U = typename arithmetic_type<T>::type;
+    return static_cast<T>(static_cast<U>(a) * static_cast<U>(b));
+  }
+
+  template<typename T>
+  inline T wrapping_add(T a, T b){
+    using U = typename arithmetic_type<T>::type;
+    return static_cast<T>(static_cast<U>(a) + static_cast<U>(b));
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+void Lua::ArrayKernels<T>::scale(T* data, size_t size, T factor){
+  for(size_t i=0; i<size; i++){
+    data[i] = wrapping_multiply(data[i], factor);
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+void Lua::ArrayKernels<T>::add(T* data, size_t size, T value){
+  for(size_t i=0; i<size; i++){
+    data[i] = wrapping_add(data[i], value);
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+void Lua::ArrayKernels<T>::add(T* data, size_t size, const T* other){
+  for(size_t i=0; i<size; i++){
+    data[i] = wrapping_add(data[i], other[i]);
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+void Lua::ArrayKernels<T>::fma(T* data, size_t size, const T* other, T factor){
+  for(size_t i=0; i<size; i++){
+    data[i] = wrapping_add(data[i], wrapping_multiply(factor, other[i]));
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+void Lua::ArrayKernels<T>::clamp(T* data, size_t size, T low, T high){
+  for(size_t i=0; i<size; i++){
+    T value = data[i];
+    value = (value < low) ? low : value;
+    value = (high < value) ? high : value;
+    data[i] = value;
+  }
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+Lua::array_accumulator<T> Lua::ArrayKernels<T>::sum(const T* data, size_t size){
+  using S = typename sum_type<T>::type;
+
+  S partial[lanes] = {};
+  size_t i = 0;
+  for(; i + lanes <= size; i += lanes){
+    for(size_t j=0; j<lanes; j++){
+      partial[j] += static_cast<S>(data[i+j]);
+    }
+  }
+
+  S total = 0;
+  for(size_t j=0; j<lanes; j++){
+    total += partial[j];
+  }
+  for(; i<size; i++){
+    total += static_cast<S>(data[i]);
+  }
+  return static_cast<array_accumulator<T> >(total);
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+Lua::array_accumulator<T> Lua::ArrayKernels<T>::dot(const T* data, size_t size, const T* other){
+  using S = typename sum_type<T>::type;
+
+  S partial[lanes] = {};
+  size_t i = 0;
+  for(; i + lanes <= size; i += lanes){
+    for(size_t j=0; j<lanes; j++){
+      partial[j] += static_cast<S>(data[i+j]) * static_cast<S>(other[i+j]);
+    }
+  }
+
+  S total = 0;
+  for(size_t j=0; j<lanes; j++){
+    total += partial[j];
+  }
+  for(; i<size; i++){
+    total += static_cast<S>(data[i]) * static_cast<S>(other[i]);
+  }
+  return static_cast<array_accumulator<T> >(total);
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+T Lua::ArrayKernels<T>::min(const T* data, size_t size){
+  T partial[lanes];
+  for(size_t j=0; j<lanes; j++){
+    partial[j] = data[0];
+  }
+
+  size_t i = 0;
+  for(; i + lanes <= size; i += lanes){
+    for(size_t j=0; j<lanes; j++){
+      partial[j] = (data[i+j] < partial[j]) ? data[i+j] : partial[j];
+    }
+  }
+
+  T output = partial[0];
+  for(size_t j=1; j<lanes; j++){
+    output = (partial[j] < output) ? partial[j] : output;
+  }
+  for(; i<size; i++){
+    output = (data[i] < output) ? data[i] : output;
+  }
+  return output;
+}
+
+template<typename T>
+LUA_ARRAY_KERNEL
+T Lua::ArrayKernels<T>::max(const T* data, size_t size){
+  T partial[lanes];
+  for(size_t j=0; j<lanes; j++){
+    partial[j] = data[0];
+  }
+
+  size_t i = 0;
+  for(; i + lanes <= size; i += lanes){
+    for(size_t j=0; j<lanes; j++){
+      partial[j] = (partial[j] < data[i+j]) ? data[i+j] : partial[j];
+    }
+  }
+
+  T output = partial[0];
+  for(size_t j=1; j<lanes; j++){
+    output = (output < partial[j]) ? partial[j] : output;
+  }
+  for(; i<size; i++){
+    output = (output < data[i]) ? data[i] : output;
+  }
+  return output;
+}
+
+// Every type accepted by ArrayView.
+template struct Lua::ArrayKernels<char>;
+template struct Lua::ArrayKernels<signed char>;
+template struct Lua::ArrayKernels<unsigned char>;
+template struct Lua::ArrayKernels<wchar_t>;
+template struct Lua::ArrayKernels<char16_t>;
+template struct Lua::ArrayKernels<char32_t>;
+template struct Lua::ArrayKernels<short>;
+template struct Lua::ArrayKernels<unsigned short>;
+template struct Lua::ArrayKernels<int>;
+template struct Lua::ArrayKernels<unsigned int>;
+template struct Lua::ArrayKernels<long>;
+template struct Lua::ArrayKernels<unsigned long>;
+template struct Lua::ArrayKernels<long long>;
+template struct Lua::ArrayKernels<unsigned long long>;
+template struct Lua::ArrayKernels<float>;
+template struct Lua::ArrayKernels<double>;
+template struct Lua::ArrayKernels<long double>;
@@ -0,0 +1,224 @@
+#include "lua-bindings/detail/LuaBytecodeCache.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "lua-bindings/detail/LuaExceptions.hh"
+#include "lua-bindings/detail/LuaPush.hh"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LUA_BYTECODE_CACHE_SUPPORTED
+#endif
+
+#ifdef LUA_BYTECODE_CACHE_SUPPORTED
+
+namespace {
+  const char cache_magic[] = "LBC1";
+
+  // 64-bit FNV-1a hash.
+  uint64_t fnv1a(const char* data, size_t size){
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i=0; i<size; i++){
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  std::string hex(uint64_t value){
+    char buffer[17];
+    std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+    return buffer;
+  }
+
+  template<typename T>
+  void append_raw(std::string& output, T value){
+    output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  // The start of each cache entry, identifying the source it was compiled from.
+  // An entry is only used if its header matches exactly,
+  //   so that a collision in the file name never loads the wrong bytecode.
+  std::string cache_header(const char* filename, uint64_t content_hash, uint64_t content_size){
+    std::string output(cache_magic, 4);
+    append_raw<int32_t>(output, LUA_VERSION_NUM);
+    append_raw<uint64_t>(output, content_hash);
+    append_raw<uint64_t>(output, content_size);
+    append_raw<uint64_t>(output, std::strlen(filename));
+    output += filename;
+    return output;
+  }
+
+  bool read_source(const char* filename, std::string& contents){
+    std::ifstream in(filename, std::ios::binary);
+    if(!in){
+      return false;
+    }
+
+    in.seekg(0, std::ios::end);
+    std::streamoff size = in.tellg();
+    if(size < 0){
+      return false;
+    }
+    in.seekg(0, std::ios::beg);
+
+    contents.resize(size);
+    in.read(&contents[0], size);
+    return !in.fail();
+  }
+
+  // Returns the start of the code, skipping a UTF-8 byte order mark and a leading '#' line,
+  //   as luaL_loadfilex does.
+  // The newline ending the '#' line is kept, so that line numbers are unchanged.
+  size_t code_start(const std::string& source){
+    size_t start = 0;
+    if(source.compare(0, 3, "\xEF\xBB\xBF") == 0){
+      start = 3;
+    }
+    if(start < source.size() && source[start] == '#'){
+      start = source.find('\n', start);
+      if(start == std::string::npos){
+        start = source.size();
+      }
+    }
+    return start;
+  }
+
+  bool is_trusted(const struct stat& info){
+    return info.st_uid == geteuid() && !(info.st_mode & (S_IWGRP | S_IWOTH));
+  }
+
+  // The directory itself must be trusted, and must not be a symbolic link.
+  bool is_trusted_directory(const std::string& cache_dir){
+    struct stat info;
+    return lstat(cache_dir.c_str(), &info) == 0 && S_ISDIR(info.st_mode) && is_trusted(info);
+  }
+
+  // Reads a cache entry, only if it is a regular file that is trusted.
+  bool read_cache_entry(const std::string& path, std::string& contents){
+    int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd < 0){
+      return false;
+    }
+
+    struct stat info;
+    bool success = (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && is_trusted(info));
+    if(success){
+      contents.resize(info.st_size);
+      size_t total = 0;
+      while(total < contents.size()){
+        ssize_t n = read(fd, &contents[total], contents.size() - total);
+        if(n <= 0){
+          success = false;
+          break;
+        }
+        total += n;
+      }
+    }
+
+    close(fd);
+    return success;
+  }
+
+  // Writes to a temporary file, then renames it into place,
+  //   so that a partially written entry is never read.
+  void write_cache_entry(const std::string& path, const std::string& contents){
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if(fd < 0){
+      return;
+    }
+
+    bool success = (fchmod(fd, 0600) == 0);
+    size_t total = 0;
+    while(success && total < contents.size()){
+      ssize_t n = write(fd, contents.data() + total, contents.size() - total);
+      if(n <= 0){
+        success = false;
+      } else {
+        total += n;
+      }
+    }
+
+    success = (close(fd) == 0) && success;
+    if(!success || rename(temp_path.c_str(), path.c_str()) != 0){
+      unlink(temp_path.c_str());
+    }
+  }
+
+  int append_to_string(lua_State*, const void* data, size_t size, void* output){
+    static_cast<std::string*>(output)->append(static_cast<const char*>(data), size);
+    return 0;
+  }
+}
+
+bool Lua::InitializeBytecodeCache(const std::string& cache_dir){
+  if(mkdir(cache_dir.c_str(), 0700) != 0 && errno != EEXIST){
+    return false;
+  }
+  return is_trusted_directory(cache_dir);
+}
+
+void Lua::PushCodeFileCached(lua_State* L, const char* filename, const std::string& cache_dir){
+  std::string source;
+  if(!read_source(filename, source)){
+    throw LuaFileNotFound(filename);
+  }
+
+  // Same chunkname as luaL_loadfilex.
+  std::string chunkname = std::string("@") + filename;
+  size_t start = code_start(source);
+  const char* code = source.data() + start;
+  size_t code_size = source.size() - start;
+
+  if(!is_trusted_directory(cache_dir)){
+    PushCodeBuffer(L, code, code_size, chunkname.c_str(), "t");
+    return;
+  }
+
+  uint64_t content_hash = fnv1a(source.data(), source.size());
+  std::string header = cache_header(filename, content_hash, source.size());
+  std::string path = (cache_dir + "/" +
+                      hex(fnv1a(filename, std::strlen(filename))) + "-" +
+                      hex(content_hash) + "-" +
+                      std::to_string(LUA_VERSION_NUM) + ".luac");
+
+  std::string entry;
+  if(read_cache_entry(path, entry) &&
+     entry.size() > header.size() &&
+     entry.compare(0, header.size(), header) == 0){
+    int load_result = luaL_loadbufferx(L, entry.data() + header.size(), entry.size() - header.size(),
+                                       chunkname.c_str(), "b");
+    if(load_result == LUA_OK){
+      return;
+    }
+    // Unreadable bytecode, such as from a differently configured Lua.
+    // Compile from source, and replace the entry.
+    lua_pop(L, 1);
+  }
+
+  PushCodeBuffer(L, code, code_size, chunkname.c_str(), "t");
+
+  std::string bytecode = header;
+  if(lua_dump(L, append_to_string, &bytecode, 0) == 0){
+    write_cache_entry(path, bytecode);
+  }
+}
+
+#else
+
+bool Lua::InitializeBytecodeCache(const std::string&){
+  return false;
+}
+
+void Lua::PushCodeFileCached(lua_State* L, const char* filename, const std::string&){
+  PushCodeFile(L, filename);
+}
+
+#endif
@@ -5,6 +5,14 @@
 int Lua::LuaCallable::call_noexcept(lua_State* L){
   try{
     return call(L);
+  } catch (...) {
+    return cpp_exception_to_lua_error(L);
+  }
+}
+
+int Lua::cpp_exception_to_lua_error(lua_State* L){
+  try{
+    throw;
   } catch (std::exception& e) {
     return luaL_error(L, "C++ exception: %s", e.what());
   } catch (...) {
@@ -13,13 +21,23 @@ int Lua::LuaCallable::call_noexcept(lua_State* L){
 }
 
 int Lua::call_cpp_function(lua_State* L){
-  void* storage = lua_touserdata(L, 1);
+  void* storage = lua_touserdata(L, lua_upvalueindex(1));
   Lua::LuaCallable* callable = *static_cast<Lua::LuaCallable**>(storage);
-  lua_remove(L, 1);
   int args_returned = callable->call_noexcept(L);
   return args_returned;
 }
 
+Lua::LuaCallable* Lua::GetLuaCallable(lua_State* L, int index){
+  if(lua_tocfunction(L, index) != call_cpp_function){
+    return nullptr;
+  }
+
+  lua_getupvalue(L, index, 1);
+  void* storage = lua_touserdata(L, -1);
+  lua_pop(L, 1);
+  return *static_cast<Lua::LuaCallable**>(storage);
+}
+
 int Lua::garbage_collect_cpp_function(lua_State* L){
   void* storage = lua_touserdata(L, 1);
   Lua::LuaCallable* callable = *static_cast<Lua::LuaCallable**>(storage);
@@ -0,0 +1,129 @@
+#include "lua-bindings/detail/LuaChunkReader.hh"
+
+#include <exception>
+#include <fstream>
+#include <iterator>
+
+#include "lua-bindings/detail/LuaExceptions.hh"
+#include "lua-bindings/detail/LuaRead.hh"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LUA_MAPPED_FILE_SUPPORTED
+#endif
+
+#ifdef LUA_MAPPED_FILE_SUPPORTED
+
+Lua::MappedFileReader::MappedFileReader(const char* filename)
+  : data(nullptr), length(0), finished(false) {
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if(fd < 0){
+    throw LuaFileNotFound(filename);
+  }
+
+  struct stat info;
+  if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+    close(fd);
+    throw LuaFileNotFound(filename);
+  }
+
+  // A zero-length mapping is not allowed, and is not needed.
+  length = info.st_size;
+  if(length){
+    data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+
+  if(data == MAP_FAILED){
+    throw LuaFileNotFound(filename);
+  }
+}
+
+Lua::MappedFileReader::~MappedFileReader(){
+  if(data){
+    munmap(data, length);
+  }
+}
+
+#else
+
+Lua::MappedFileReader::MappedFileReader(const char* filename)
+  : data(nullptr), length(0), finished(false) {
+  std::ifstream in(filename, std::ios::binary);
+  if(!in){
+    throw LuaFileNotFound(filename);
+  }
+  fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  data = &fallback[0];
+  length = fallback.size();
+}
+
+Lua::MappedFileReader::~MappedFileReader() { }
+
+#endif
+
+const char* Lua::MappedFileReader::Read(size_t& size){
+  if(finished || !length){
+    size = 0;
+    return nullptr;
+  }
+  finished = true;
+  size = length;
+  return static_cast<const char*>(data);
+}
+
+Lua::StreamReader::StreamReader(std::istream& stream, size_t block_size)
+  : stream(stream), buffer(block_size) { }
+
+const char* Lua::StreamReader::Read(size_t& size){
+  stream.read(buffer.data(), buffer.size());
+  if(stream.bad()){
+    throw LuaStreamReadError("Error while reading Lua code from stream");
+  }
+  size = stream.gcount();
+  return size ? buffer.data() : nullptr;
+}
+
+namespace {
+  struct ReaderState{
+    Lua::ChunkReader& reader;
+    std::exception_ptr error;
+  };
+
+  // lua_load runs in protected mode, which would swallow a C++ exception.
+  // Instead, the exception is saved, the end of the code is reported,
+  //   and the exception is rethrown after lua_load returns.
+  const char* read_block(lua_State*, void* data, size_t* size){
+    ReaderState* state = static_cast<ReaderState*>(data);
+    try{
+      const char* output = state->reader.Read(*size);
+      if(!output){
+        *size = 0;
+      }
+      return output;
+    } catch(...) {
+      state->error = std::current_exception();
+      *size = 0;
+      return nullptr;
+    }
+  }
+}
+
+void Lua::PushCodeStream(lua_State* L, ChunkReader& reader, const char* chunkname){
+  ReaderState state{reader, nullptr};
+  int load_result = lua_load(L, read_block, &state, chunkname, "t");
+
+  if(state.error){
+    lua_pop(L, 1);
+    std::rethrow_exception(state.error);
+  }
+
+  if(load_result){
+    auto error_message = Lua::Read<std::string>(L, -1);
+    lua_pop(L, 1);
+    throw LuaFileParseError(error_message);
+  }
+}
@@ -16,3 +16,9 @@ Lua::FunctionWrapper::~FunctionWrapper(){
     AllowToDie(shared_L.get(), reference);
   }
 }
+
+lua_State* Lua::FunctionWrapper::PushFunction() const{
+  lua_State* L = shared_L.get();
+  PushLivingToStack(L, reference);
+  return L;
+}
@@ -0,0 +1,81 @@
+#include "lua-bindings/detail/LuaIdentityCache.hh"
+
+#include "lua-bindings/detail/LuaRegistryNames.hh"
+
+namespace {
+  const void* cache_key(Lua::IdentityCacheKind kind){
+    switch(kind){
+    case Lua::IdentityCacheKind::SharedPointer:
+      return &Lua::cpp_shared_identity_cache;
+    case Lua::IdentityCacheKind::CPointer:
+    default:
+      return &Lua::cpp_cpointer_identity_cache;
+    }
+  }
+
+  // Pushes the cache of a single class, creating it if requested.
+  // Returns false, with nothing pushed, if it does not exist.
+  bool push_class_cache(lua_State* L, Lua::IdentityCacheKind kind, void* class_key, bool create){
+    if(lua_rawgetp(L, LUA_REGISTRYINDEX, cache_key(kind)) != LUA_TTABLE){
+      lua_pop(L, 1);
+      return false;
+    }
+
+    if(lua_rawgetp(L, -1, class_key) == LUA_TTABLE){
+      lua_remove(L, -2);
+      return true;
+    }
+    lua_pop(L, 1);
+
+    if(!create){
+      lua_pop(L, 1);
+      return false;
+    }
+
+    // Values are weak, so that the cache does not keep anything alive.
+    lua_newtable(L);
+    lua_createtable(L, 0, 1);
+    lua_pushliteral(L, "v");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, -3, class_key);
+    lua_remove(L, -2);
+    return true;
+  }
+}
+
+void Lua::EnableIdentityCache(lua_State* L){
+  for(auto kind : {IdentityCacheKind::SharedPointer, IdentityCacheKind::CPointer}){
+    if(lua_rawgetp(L, LUA_REGISTRYINDEX, cache_key(kind)) != LUA_TTABLE){
+      lua_newtable(L);
+      lua_rawsetp(L, LUA_REGISTRYINDEX, cache_key(kind));
+    }
+    lua_pop(L, 1);
+  }
+}
+
+bool Lua::PushCachedIdentity(lua_State* L, IdentityCacheKind kind, void* class_key, const void* address){
+  if(!address || !push_class_cache(L, kind, class_key, false)){
+    return false;
+  }
+
+  if(lua_rawgetp(L, -1, address) == LUA_TUSERDATA){
+    lua_remove(L, -2);
+    return true;
+  }
+
+  lua_pop(L, 2);
+  return false;
+}
+
+void Lua::CacheIdentity(lua_State* L, IdentityCacheKind kind, void* class_key, const void* address){
+  if(!address || !push_class_cache(L, kind, class_key, true)){
+    return;
+  }
+
+  lua_pushvalue(L, -2);
+  lua_rawsetp(L, -2, address);
+  lua_pop(L, 1);
+}
@@ -1,8 +1,79 @@
 #include "lua-bindings/detail/LuaPointerType.hh"
 
+#include <cstring>
+#include <vector>
+
 int Lua::garbage_collect_upcaster(lua_State* L){
   void* storage = lua_touserdata(L, 1);
   Lua::Upcaster* upcaster = *static_cast<Lua::Upcaster**>(storage);
   delete upcaster;
   return 0;
 }
+
+void Lua::PushUpcastChain(lua_State* L, void* class_key, void* nonconst_class_key){
+  int obj_metatable = lua_absindex(L, -1);
+
+  lua_rawgetp(L, LUA_REGISTRYINDEX, class_key);
+  int class_metatable = lua_absindex(L, -1);
+  lua_rawgetp(L, LUA_REGISTRYINDEX, nonconst_class_key);
+  int class_metatable_nonconst = lua_absindex(L, -1);
+  bool class_registered = !lua_isnil(L, class_metatable) || !lua_isnil(L, class_metatable_nonconst);
+
+  bool is_correct_class = false;
+  std::vector<Upcaster*> upcasters;
+
+  // The userdata owning each Upcaster, so that the chain can keep them alive.
+  lua_newtable(L);
+  int owners = lua_absindex(L, -1);
+
+  lua_pushvalue(L, obj_metatable);
+  while(lua_istable(L, -1)){
+    // If 'const' is requested, can also return a non-const version.
+    // This will not, however, cause the non-const request to return a const version.
+    is_correct_class = (lua_rawequal(L, -1, class_metatable) ||
+                        lua_rawequal(L, -1, class_metatable_nonconst));
+    if(is_correct_class){
+      break;
+    }
+
+    if(lua_getfield(L, -1, "upcaster") == LUA_TUSERDATA){
+      upcasters.push_back(*static_cast<Upcaster**>(lua_touserdata(L, -1)));
+      lua_rawseti(L, owners, upcasters.size());
+    } else {
+      lua_pop(L, 1);
+    }
+
+    lua_getfield(L, -1, "base");
+    lua_remove(L, -2);
+  }
+  lua_pop(L, 1);
+
+  if(is_correct_class){
+    size_t memsize = upcasters.size() * sizeof(Upcaster*);
+    void* storage = lua_newuserdata(L, memsize);
+    if(memsize){
+      std::memcpy(storage, upcasters.data(), memsize);
+    }
+    // Calling MakeClass again replaces the "upcaster" entries of the metatables.
+    // The chain must keep the previous ones alive, since it holds pointers to them.
+    lua_pushvalue(L, owners);
+    lua_setuservalue(L, -2);
+  } else {
+    lua_pushboolean(L, false);
+  }
+  lua_replace(L, class_metatable);
+  lua_pop(L, 2);
+
+  // Only cache inside of metatables made by MakeClass.
+  // Other userdata may have metatables that we should not modify.
+  lua_getfield(L, obj_metatable, "__gc");
+  bool is_class_metatable = lua_tocfunction(L, -1) == HeldPointer::garbage_collect;
+  lua_pop(L, 1);
+
+  // A failure is only cached once the requested class is registered.
+  // Otherwise, registering the class later would have no effect.
+  if(is_class_metatable && (is_correct_class || class_registered)){
+    lua_pushvalue(L, -1);
+    lua_rawsetp(L, obj_metatable, class_key);
+  }
+}
@@ -18,11 +18,21 @@ void Lua::PushValueDirect(lua_State* L, bool b){
   lua_pushboolean(L, b);
 }
 
-void Lua::PushValueDirect(lua_State* L, std::string string){
-  PushValueDirect(L, string.c_str());
+void Lua::PushValueDirect(lua_State* L, const std::string& string){
+  lua_pushlstring(L, string.data(), string.size());
 }
 
-void Lua::PushValueDirect(lua_State*, LuaObject& obj){
+void Lua::PushValueDirect(lua_State* L, StringRef string){
+  lua_pushlstring(L, string.data(), string.size());
+}
+
+#if __cplusplus >= 201703L
+void Lua::PushValueDirect(lua_State* L, std::string_view string){
+  lua_pushlstring(L, string.data(), string.size());
+}
+#endif
+
+void Lua::PushValueDirect(lua_State*, LuaObject obj){
   obj.MoveToTop();
 }
 
@@ -36,6 +46,7 @@ void Lua::PushValueDirect(lua_State* L, void* cpointer) {
 
 void Lua::PushValueDirect(lua_State* L, Lua::LuaCallable* callable){
   // Define a new userdata, storing the LuaCallable in it.
+  // The userdata is only responsible for deleting the LuaCallable.
   void* userdata = lua_newuserdata(L, sizeof(callable));
   *static_cast<Lua::LuaCallable**>(userdata) = callable;
 
@@ -43,11 +54,13 @@ void Lua::PushValueDirect(lua_State* L, Lua::LuaCallable* callable){
   int metatable_uninitialized = luaL_newmetatable(L, cpp_function_registry_entry.c_str());
   if(metatable_uninitialized){
     Lua::LuaObject table(L);
-    table["__call"] = call_cpp_function;
     table["__gc"] = garbage_collect_cpp_function;
     table["__metatable"] = "Access restricted";
   }
   lua_setmetatable(L, -2);
+
+  // Lua calls the closure directly, with the userdata as its upvalue.
+  lua_pushcclosure(L, call_cpp_function, 1);
 }
 
 void Lua::PushValueDirect(lua_State* L, Lua::Upcaster* callable){
@@ -69,6 +82,7 @@ void Lua::PushCodeFile(lua_State* L, const char* filename){
   int load_result = luaL_loadfilex(L, filename, "t");
   if(load_result){
     auto error_message = Lua::Read<std::string>(L, -1);
+    lua_pop(L, 1);
     if(load_result == LUA_ERRFILE){
       throw LuaFileNotFound(filename);
     } else {
@@ -78,9 +92,16 @@ void Lua::PushCodeFile(lua_State* L, const char* filename){
 }
 
 void Lua::PushCodeString(lua_State* L, const std::string& lua_code){
-  int load_result = luaL_loadstring(L, lua_code.c_str());
+  // Same chunkname as luaL_loadstring.
+  PushCodeBuffer(L, lua_code.data(), lua_code.size(), lua_code.c_str());
+}
+
+void Lua::PushCodeBuffer(lua_State* L, const char* buffer, size_t size, const char* chunkname,
+                         const char* mode){
+  int load_result = luaL_loadbufferx(L, buffer, size, chunkname, mode);
   if(load_result){
     auto error_message = Lua::Read<std::string>(L, -1);
+    lua_pop(L, 1);
     throw LuaFileParseError(error_message);
   }
 }
@@ -1,6 +1,6 @@
 #include "lua-bindings/detail/LuaReferenceSet.hh"
 
-#include <set>
+#include <vector>
 
 #include <lua.hpp>
 
@@ -11,69 +11,76 @@
 #include "lua-bindings/detail/LuaTableReference.hh"
 
 namespace{
-  int garbage_collect_reference_set(lua_State* L){
+  //! The calls from C++ into Lua that are currently running.
+  /*! call_ids[i] is the id of the call running at depth i.
+    Depth 0 is never removed, and holds references made outside of any call.
+   */
+  struct ReferenceFrames{
+    ReferenceFrames() : call_ids(1, 1), next_call_id(2) {
+      // Avoid allocating when entering a call, unless calls are deeply nested.
+      call_ids.reserve(16);
+    }
+
+    std::vector<unsigned long> call_ids;
+    unsigned long next_call_id;
+  };
+
+  int garbage_collect_reference_frames(lua_State* L){
     void* storage = lua_touserdata(L, 1);
-    auto reference_set = static_cast<std::set<unsigned long>*>(storage);
-    reference_set->~set();
+    auto frames = static_cast<ReferenceFrames*>(storage);
+    frames->~ReferenceFrames();
     return 0;
   }
+
+  ReferenceFrames& GetReferenceFrames(lua_State* L){
+    // Keyed by the address of the name, to avoid hashing the name on each lookup.
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &Lua::cpp_reference_frames);
+    void* storage = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return *static_cast<ReferenceFrames*>(storage);
+  }
 }
 
 void Lua::InitializeValidReferenceTable(lua_State* L){
-  LuaObject registry(L, LUA_REGISTRYINDEX);
-  registry[cpp_reference_counter] = 1;
-
-  // Make a std::set<unsigned long> in lua-controlled memory.
-  int memsize = sizeof(std::set<unsigned long>);
+  // Make the ReferenceFrames in lua-controlled memory.
+  int memsize = sizeof(ReferenceFrames);
   void* storage = lua_newuserdata(L, memsize);
-  new (storage) std::set<unsigned long>();
+  new (storage) ReferenceFrames();
 
-  // Garbage collect the std::set appropriately
-  luaL_newmetatable(L, cpp_reference_set_metatable.c_str());
+  // Garbage collect the ReferenceFrames appropriately
+  luaL_newmetatable(L, cpp_reference_frames_metatable.c_str());
   LuaObject table(L);
-  table["__gc"] = garbage_collect_reference_set;
+  table["__gc"] = garbage_collect_reference_frames;
   table["__metatable"] = "Access restricted";
   lua_setmetatable(L, -2);
 
   // Add to registry
-  registry[cpp_valid_reference_set] = LuaObject(L, -1);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &cpp_reference_frames);
 }
 
-bool Lua::IsValidReference(lua_State* L, unsigned long reference_id){
-  if(reference_id == 0){
+bool Lua::IsValidReference(lua_State* L, ReferenceID reference_id){
+  if(reference_id.call_id == 0){
     return true;
   } else {
-    LuaObject registry(L, LUA_REGISTRYINDEX);
-    void* storage = registry[cpp_valid_reference_set].Cast<void*>();
-    auto reference_set = static_cast<std::set<unsigned long>*>(storage);
-    return reference_set->count(reference_id);
+    auto& frames = GetReferenceFrames(L);
+    return (reference_id.depth < frames.call_ids.size() &&
+            frames.call_ids[reference_id.depth] == reference_id.call_id);
   }
 }
 
-unsigned long Lua::GenerateReferenceID(lua_State* L) {
-  LuaObject registry(L, LUA_REGISTRYINDEX);
-  auto next_index_ref = registry[cpp_reference_counter];
-  int next_index = next_index_ref.Cast<int>();
-  next_index_ref = next_index + 1;
-
-  void* set_voidp = registry[cpp_valid_reference_set].Cast<void*>();
-  std::set<unsigned long>* reference_set = static_cast<std::set<unsigned long>*>(set_voidp);
-  reference_set->insert(next_index);
-
-  return next_index;
+Lua::ReferenceID Lua::GenerateReferenceID(lua_State* L) {
+  auto& frames = GetReferenceFrames(L);
+  size_t depth = frames.call_ids.size() - 1;
+  return ReferenceID(depth, frames.call_ids[depth]);
 }
 
 Lua::PreserveValidReferences::PreserveValidReferences(lua_State* L)
   : L(L) {
-  LuaObject registry(L, LUA_REGISTRYINDEX);
-  void* storage = registry[cpp_valid_reference_set].Cast<void*>();
-  auto reference_set = static_cast<std::set<unsigned long>*>(storage);
-  saved_values = *reference_set;
+  auto& frames = GetReferenceFrames(L);
+  frames.call_ids.push_back(frames.next_call_id++);
 }
 
 Lua::PreserveValidReferences::~PreserveValidReferences(){
-  LuaObject registry(L, LUA_REGISTRYINDEX);
-  void* storage = registry[cpp_valid_reference_set].Cast<void*>();
-  auto reference_set = static_cast<std::set<unsigned long>*>(storage);
-  *reference_set = std::move(saved_values);
+  auto& frames = GetReferenceFrames(L);
+  frames.call_ids.pop_back();
 }
@@ -4,9 +4,11 @@ const std::string Lua::cpp_function_registry_entry = "Lua.Cpp.Function.Metatable
 
 const std::string Lua::upcaster_registry_entry = "Lua.Upcaster.Metatable";
 
-const std::string Lua::cpp_reference_counter = "Lua.Cpp.Reference.Counter";
-const std::string Lua::cpp_valid_reference_set = "Lua.Cpp.Valid.Reference.Set";
-const std::string Lua::cpp_reference_set_metatable = "Lua.Cpp.Reference.Set.Metatable";
+const std::string Lua::cpp_reference_frames = "Lua.Cpp.Reference.Frames";
+const std::string Lua::cpp_reference_frames_metatable = "Lua.Cpp.Reference.Frames.Metatable";
+
+const std::string Lua::cpp_shared_identity_cache = "Lua.Cpp.Identity.Cache.Shared";
+const std::string Lua::cpp_cpointer_identity_cache = "Lua.Cpp.Identity.Cache.CPointer";
 
 const std::string Lua::keepalive_table = "Lua.KeepAlive.Table";
 
@@ -28,6 +28,16 @@ Lua::LuaState::LuaState(){
 
 Lua::LuaState::~LuaState() { }
 
+bool Lua::LuaState::SetBytecodeCache(const std::string& cache_dir){
+  if(InitializeBytecodeCache(cache_dir)){
+    bytecode_cache_dir = cache_dir;
+    return true;
+  } else {
+    bytecode_cache_dir.clear();
+    return false;
+  }
+}
+
 void Lua::LuaState::LoadLibs(){
   luaL_openlibs(state());
 }
@@ -0,0 +1,102 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lua-bindings/LuaState.hh"
+
+TEST(LuaArrayView, ReadWriteFromLua){
+  Lua::LuaState L;
+  L.LoadString("function double_elements(array) "
+               "  for i=1,#array do "
+               "    array[i] = 2*array[i] "
+               "  end "
+               "end");
+
+  auto vec = std::make_shared<std::vector<double> >(std::vector<double>{1.5, 2.5, 3.5});
+  L.Call("double_elements", Lua::ArrayView<double>(vec));
+  EXPECT_EQ(*vec, std::vector<double>({3.0, 5.0, 7.0}));
+
+  int buffer[4] = {1, 2, 3, 4};
+  L.Call("double_elements", Lua::ArrayView<int>::Borrow(buffer, 4));
+  EXPECT_EQ(buffer[3], 8);
+}
+
+TEST(LuaArrayView, Bounds){
+  Lua::LuaState L;
+  L.SetGlobal("array", Lua::ArrayView<int>(std::vector<int>{1, 2, 3}));
+
+  EXPECT_EQ(L.LoadString<int>("return #array"), 3);
+  EXPECT_TRUE(L.LoadString<bool>("return array[0] == nil and array[4] == nil"));
+  EXPECT_THROW(L.LoadString("array[4] = 1"), Lua::LuaExecuteError);
+  EXPECT_THROW(L.LoadString("array[1] = 'not a number'"), Lua::LuaExecuteError);
+  EXPECT_THROW(L.LoadString("array:fill({})"), Lua::LuaExecuteError);
+}
+
+TEST(LuaArrayView, Methods){
+  Lua::LuaState L;
+  L.SetGlobal("array", Lua::ArrayView<double>(std::vector<double>(5)));
+
+  L.LoadString("array:fill(1.5)");
+  L.LoadString("copy = array:copy(); copy[1] = 0");
+  auto table = L.LoadString<std::vector<double> >("return array:totable()");
+  EXPECT_EQ(table, std::vector<double>(5, 1.5));
+
+  auto array = L.CastGlobal<Lua::ArrayView<double> >("array");
+  auto copy = L.CastGlobal<Lua::ArrayView<double> >("copy");
+  EXPECT_EQ(array.size(), 5u);
+  EXPECT_EQ(array[0], 1.5);
+  EXPECT_EQ(copy[0], 0.0);
+
+  EXPECT_THROW(L.CastGlobal<Lua::ArrayView<int> >("array"), Lua::LuaInvalidStackContents);
+}
+
+TEST(LuaArrayView, BulkOperations){
+  Lua::LuaState L;
+  // Not a multiple of the vector width, to include the remainder loops.
+  std::vector<double> x(1003), y(1003);
+  for(size_t i=0; i<x.size(); i++){
+    x[i] = i;
+    y[i] = 1;
+  }
+  L.SetGlobal("x", Lua::ArrayView<double>::Borrow(x.data(), x.size()));
+  L.SetGlobal("y", Lua::ArrayView<double>::Borrow(y.data(), y.size()));
+
+  EXPECT_EQ(L.LoadString<double>("return x:sum()"), 1002*1003/2);
+  EXPECT_EQ(L.LoadString<double>("return x:dot(y)"), 1002*1003/2);
+  EXPECT_EQ(L.LoadString<double>("return x:min()"), 0);
+  EXPECT_EQ(L.LoadString<double>("return x:max()"), 1002);
+
+  L.LoadString("y:scale(3):add(1):fma(2, x)");
+  EXPECT_EQ(y[0], 4);
+  EXPECT_EQ(y[1002], 2008);
+
+  L.LoadString("x:clamp(10, 20)");
+  EXPECT_EQ(x[0], 10);
+  EXPECT_EQ(x[15], 15);
+  EXPECT_EQ(x[1002], 20);
+
+  L.SetGlobal("short", Lua::ArrayView<double>(std::vector<double>(5)));
+  EXPECT_THROW(L.LoadString("x:add(short)"), Lua::LuaExecuteError);
+  EXPECT_THROW(L.LoadString("x:clamp(2, 1)"), Lua::LuaExecuteError);
+  EXPECT_TRUE(L.LoadString<bool>("return short:copy():scale(0):max() == 0"));
+}
+
+TEST(LuaArrayView, BulkOperationsIntegers){
+  Lua::LuaState L;
+  L.LoadLibs();
+  L.SetGlobal("array", Lua::ArrayView<int>(std::vector<int>{3, -7, 12, 5, 0, 1, 9, -2, 4}));
+  L.SetGlobal("empty", Lua::ArrayView<int>());
+
+  EXPECT_TRUE(L.LoadString<bool>("return math.type(array:sum()) == 'integer'"));
+  EXPECT_EQ(L.LoadString<int>("return array:sum()"), 25);
+  EXPECT_EQ(L.LoadString<int>("return array:dot(array)"), 329);
+  EXPECT_EQ(L.LoadString<int>("return array:min()"), -7);
+  EXPECT_EQ(L.LoadString<int>("return array:max()"), 12);
+  EXPECT_TRUE(L.LoadString<bool>("return empty:min() == nil and empty:sum() == 0"));
+
+  L.SetGlobal("wrapping", Lua::ArrayView<unsigned char>(std::vector<unsigned char>{200, 100}));
+  L.LoadString("wrapping:add(100)");
+  EXPECT_EQ(L.LoadString<int>("return wrapping[1]"), 44);
+  EXPECT_EQ(L.LoadString<int>("return wrapping[2]"), 200);
+}
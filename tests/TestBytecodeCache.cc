@@ -0,0 +1,196 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "lua-bindings/LuaState.hh"
+
+namespace{
+  class LuaBytecodeCache : public ::testing::Test{
+  protected:
+    void SetUp() override {
+      char templ[] = "/tmp/lua-bindings-test-XXXXXX";
+      ASSERT_NE(mkdtemp(templ), nullptr);
+      dir = templ;
+      cache_dir = dir + "/cache";
+      script = dir + "/script.lua";
+    }
+
+    void TearDown() override {
+      std::string command = "rm -rf '" + dir + "'";
+      ASSERT_EQ(std::system(command.c_str()), 0);
+    }
+
+    void WriteScript(const std::string& contents){
+      std::ofstream(script, std::ios::binary) << contents;
+    }
+
+    // Returns the paths of all files in the cache directory.
+    std::vector<std::string> CacheEntries(){
+      std::vector<std::string> output;
+      DIR* d = opendir(cache_dir.c_str());
+      if(d){
+        while(dirent* entry = readdir(d)){
+          std::string name = entry->d_name;
+          if(name != "." && name != ".."){
+            output.push_back(cache_dir + "/" + name);
+          }
+        }
+        closedir(d);
+      }
+      return output;
+    }
+
+    // Replaces a cache entry with a well-formed entry for the current script,
+    //   whose bytecode instead runs "code".
+    void ForgeEntry(const std::string& entry, const std::string& code){
+      std::ifstream in(script, std::ios::binary);
+      std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+      std::string contents("LBC1");
+      append_raw<int32_t>(contents, LUA_VERSION_NUM);
+      append_raw<uint64_t>(contents, fnv1a(source));
+      append_raw<uint64_t>(contents, source.size());
+      append_raw<uint64_t>(contents, script.size());
+      contents += script;
+
+      lua_State* L = luaL_newstate();
+      EXPECT_EQ(luaL_loadstring(L, code.c_str()), LUA_OK);
+      EXPECT_EQ(lua_dump(L, append_to_string, &contents, 0), 0);
+      lua_close(L);
+
+      std::ofstream(entry, std::ios::binary | std::ios::trunc) << contents;
+      ASSERT_EQ(chmod(entry.c_str(), 0600), 0);
+    }
+
+    static uint64_t fnv1a(const std::string& data){
+      uint64_t hash = 14695981039346656037ull;
+      for(char c : data){
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+      }
+      return hash;
+    }
+
+    template<typename T>
+    static void append_raw(std::string& output, T value){
+      output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static int append_to_string(lua_State*, const void* data, size_t size, void* output){
+      static_cast<std::string*>(output)->append(static_cast<const char*>(data), size);
+      return 0;
+    }
+
+    std::string dir;
+    std::string cache_dir;
+    std::string script;
+  };
+}
+
+TEST_F(LuaBytecodeCache, CompiledOnce){
+  WriteScript("x = 5\nreturn x*2");
+  {
+    Lua::LuaState L;
+    ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+    EXPECT_EQ(L.LoadFile<int>(script.c_str()), 10);
+  }
+
+  auto entries = CacheEntries();
+  ASSERT_EQ(entries.size(), 1u);
+  struct stat info;
+  ASSERT_EQ(stat(entries[0].c_str(), &info), 0);
+  EXPECT_EQ(info.st_mode & 0777, 0600u);
+
+  Lua::LuaState L;
+  ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 10);
+  EXPECT_EQ(L.CastGlobal<int>("x"), 5);
+  EXPECT_EQ(CacheEntries().size(), 1u);
+}
+
+TEST_F(LuaBytecodeCache, ChangedSourceIsRecompiled){
+  Lua::LuaState L;
+  ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+
+  WriteScript("return 1");
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 1);
+
+  WriteScript("return 2");
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 2);
+  EXPECT_EQ(CacheEntries().size(), 2u);
+}
+
+TEST_F(LuaBytecodeCache, UntrustedCacheIsIgnored){
+  WriteScript("return 3");
+  Lua::LuaState L;
+  ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 3);
+
+  auto entries = CacheEntries();
+  ASSERT_EQ(entries.size(), 1u);
+
+  // A well-formed entry is used, even though it differs from the source.
+  ForgeEntry(entries[0], "return 99");
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 99);
+
+  // The same entry is ignored once others can write to it.
+  ForgeEntry(entries[0], "return 99");
+  ASSERT_EQ(chmod(entries[0].c_str(), 0666), 0);
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 3);
+
+  // Or once others can write to the directory holding it.
+  ForgeEntry(entries[0], "return 99");
+  ASSERT_EQ(chmod(cache_dir.c_str(), 0777), 0);
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 3);
+
+  EXPECT_FALSE(L.SetBytecodeCache(cache_dir));
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 3);
+}
+
+TEST_F(LuaBytecodeCache, SourceBytecodeIsRejected){
+  // Only entries written by the cache are loaded as bytecode, never the source file itself.
+  std::string bytecode;
+  lua_State* state = luaL_newstate();
+  ASSERT_EQ(luaL_loadstring(state, "return 5"), LUA_OK);
+  ASSERT_EQ(lua_dump(state, append_to_string, &bytecode, 0), 0);
+  lua_close(state);
+  WriteScript(bytecode);
+
+  Lua::LuaState L;
+  ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+  EXPECT_THROW(L.LoadFile(script.c_str()), Lua::LuaFileParseError);
+  EXPECT_TRUE(CacheEntries().empty());
+}
+
+TEST_F(LuaBytecodeCache, MatchesLoadFile){
+  Lua::LuaState L;
+  ASSERT_TRUE(L.SetBytecodeCache(cache_dir));
+
+  // A leading '#' line is skipped, without changing line numbers.
+  WriteScript("#!/usr/bin/env lua\nreturn 4");
+  EXPECT_EQ(L.LoadFile<int>(script.c_str()), 4);
+
+  WriteScript("\n\nerror('failure')");
+  for(int i=0; i<2; i++){
+    try{
+      L.LoadFile(script.c_str());
+      FAIL() << "Expected an execution error";
+    } catch(Lua::LuaExecuteError& e){
+      EXPECT_NE(std::string(e.what()).find("script.lua:3:"), std::string::npos);
+    }
+  }
+
+  WriteScript("return +");
+  EXPECT_THROW(L.LoadFile(script.c_str()), Lua::LuaFileParseError);
+  EXPECT_THROW(L.LoadFile((dir + "/missing.lua").c_str()), Lua::LuaFileNotFound);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
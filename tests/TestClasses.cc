@@ -1,3 +1,4 @@
+#include <cstdint>
 #include <memory>
 
 #include <gtest/gtest.h>
@@ -26,6 +27,24 @@ namespace{
     int x;
   };
 
+  int copy_constructor_called = 0;
+  int move_constructor_called = 0;
+
+  class MoveCounter{
+  public:
+    MoveCounter() { }
+    MoveCounter(const MoveCounter&) { copy_constructor_called++; }
+    MoveCounter(MoveCounter&&) { move_constructor_called++; }
+  };
+
+  MoveCounter make_MoveCounter(){
+    return MoveCounter();
+  }
+
+  struct alignas(32) AlignedValue{
+    double x;
+  };
+
   int reference_func(TestClass& var){
     return 3*var.GetX();
   }
@@ -42,6 +61,13 @@ namespace{
     return 6*var.GetX();
   }
 
+  void InitializeBoundClass(Lua::LuaState& L){
+    L.MakeClass<TestClass>("TestClass")
+      .AddConstructor<>("make_TestClass")
+      .AddMethod<decltype(&TestClass::GetX), &TestClass::GetX>("GetX")
+      .AddMethod<decltype(&TestClass::SetX), &TestClass::SetX>("SetX");
+  }
+
   void InitializeClass(Lua::LuaState& L){
     L.MakeClass<TestClass>("TestClass")
       .AddConstructor<>("make_TestClass")
@@ -115,6 +141,50 @@ TEST(LuaClasses, DestructorCount_PassValueToLua){
   EXPECT_EQ(destructor_called, 2);  // One destructor of C++ object plus one of Lua-held object.
 }
 
+TEST(LuaClasses, ValueHeldInPlace){
+  Lua::LuaState L;
+  InitializeClass(L);
+  L.MakeClass<AlignedValue>("AlignedValue");
+
+  TestClass var;
+  var.SetX(42);
+  L.SetGlobal("held", var);
+  auto ptr = L.CastGlobal<TestClass*>("held");
+  EXPECT_NE(ptr, &var);
+  EXPECT_EQ(ptr->GetX(), 42);
+
+  L.SetGlobal("reference_func", reference_func);
+  L.LoadString("result = reference_func(held)");
+  EXPECT_EQ(L.CastGlobal<int>("result"), 3*42);
+
+  // Only Lua owns the object, so it cannot be shared.
+  EXPECT_THROW(L.CastGlobal<std::shared_ptr<TestClass> >("held"), Lua::LuaIncorrectPointerType);
+
+  L.SetGlobal("aligned", AlignedValue{1.5});
+  auto aligned = L.CastGlobal<AlignedValue*>("aligned");
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % alignof(AlignedValue), 0);
+  EXPECT_EQ(aligned->x, 1.5);
+}
+
+TEST(LuaClasses, ReturnTemporaryIsMoved){
+  Lua::LuaState L;
+  L.MakeClass<MoveCounter>("MoveCounter");
+  L.SetGlobal("make_bound", Lua::Bind<decltype(&make_MoveCounter), &make_MoveCounter>());
+  L.SetGlobal("make_wrapped", make_MoveCounter);
+
+  copy_constructor_called = 0;
+  move_constructor_called = 0;
+  L.LoadString("var = make_bound()");
+  EXPECT_EQ(copy_constructor_called, 0);
+  EXPECT_EQ(move_constructor_called, 1);
+
+  copy_constructor_called = 0;
+  move_constructor_called = 0;
+  L.LoadString("var = make_wrapped()");
+  EXPECT_EQ(copy_constructor_called, 0);
+  EXPECT_EQ(move_constructor_called, 1);
+}
+
 TEST(LuaClasses, DestructorCount_PassReferenceToLua){
   constructor_called = 0;
   destructor_called = 0;
@@ -208,6 +278,36 @@ TEST(LuaClasses, ReturnCppClass){
   EXPECT_EQ(shared_value->GetX(), 17);
 }
 
+TEST(LuaClasses, IdentityCache){
+  Lua::LuaState L;
+  L.LoadLibs();
+  InitializeClass(L);
+  L.LoadString("function same(a, b) return rawequal(a, b) end");
+
+  auto shared = std::make_shared<TestClass>();
+  TestClass value;
+  EXPECT_FALSE(L.Call<bool>("same", shared, shared));
+  EXPECT_FALSE(L.Call<bool>("same", &value, &value));
+
+  L.EnableIdentityCache();
+  EXPECT_TRUE(L.Call<bool>("same", shared, shared));
+  EXPECT_TRUE(L.Call<bool>("same", &value, &value));
+  EXPECT_FALSE(L.Call<bool>("same", shared, shared.get()));
+
+  // Const and non-const are distinct types in Lua.
+  EXPECT_FALSE(L.Call<bool>("same", &value, static_cast<const TestClass*>(&value)));
+
+  // References are only valid for one call, and so are not cached.
+  EXPECT_FALSE(L.Call<bool>("same", std::ref(value), std::ref(value)));
+
+  // The cache does not keep the object alive.
+  L.LoadString("collectgarbage()");
+  L.SetGlobal("held", shared);
+  EXPECT_EQ(shared.use_count(), 2);
+  L.LoadString("held = nil; collectgarbage()");
+  EXPECT_EQ(shared.use_count(), 1);
+}
+
 TEST(LuaClasses, ReturnCppClassByWeakPtr){
   Lua::LuaState L;
   InitializeClass(L);
@@ -320,6 +420,46 @@ TEST(LuaClasses, ReferenceExpires){
                Lua::LuaExpiredReference);
 }
 
+TEST(LuaClasses, BorrowedReference){
+  Lua::LuaState L;
+  InitializeClass(L);
+  L.LoadString("saved_copy = nil "
+               " "
+               "function accepts_TestClass(var) "
+               "  saved_copy = var "
+               "  var:SetX(17) "
+               "  return var:GetX() "
+               "end "
+               " "
+               "function returns_afterward() "
+               "  return saved_copy "
+               "end "
+               " "
+               "function has_setter(var) "
+               "  return var.SetX ~= nil "
+               "end ");
+
+  TestClass var;
+  var.SetX(42);
+
+  auto x = L.Call<int>("accepts_TestClass", Lua::Borrow(var));
+  EXPECT_EQ(x, 17);
+  EXPECT_EQ(var.GetX(), 17);
+
+  // Borrowed references are not tracked, and so do not expire.
+  EXPECT_EQ(L.Call<TestClass*>("returns_afterward"), &var);
+
+  const TestClass& const_var = var;
+  EXPECT_TRUE(L.Call<bool>("has_setter", Lua::Borrow(var)));
+  EXPECT_FALSE(L.Call<bool>("has_setter", Lua::Borrow(const_var)));
+
+  // The userdata holds nothing but the pointer.
+  Lua::Push(L.state(), Lua::Borrow(var));
+  EXPECT_EQ(lua_rawlen(L.state(), -1), sizeof(Lua::HeldPointer*) + sizeof(Lua::VariableCPointer));
+  EXPECT_EQ(sizeof(Lua::VariableCPointer), sizeof(Lua::HeldPointer));
+  lua_pop(L.state(), 1);
+}
+
 TEST(LuaClasses, PassConst){
   Lua::LuaState L;
   InitializeClass(L);
@@ -362,3 +502,64 @@ TEST(LuaClasses, PassConstValueToCpp){
                                 "return args[1] ",
                                 std::cref(var));
 }
+
+TEST(LuaClasses, BoundMethods){
+  Lua::LuaState L;
+  InitializeBoundClass(L);
+  L.LoadString("function getter_setter()"
+               "  local var = make_TestClass()"
+               "  var:SetX(17)"
+               "  return var:GetX()"
+               "end");
+  EXPECT_EQ(L.Call<int>("getter_setter"), 17);
+
+  L.LoadString("function accepts_TestClass(var) "
+               "  var:SetX(42) "
+               "end "
+               "function const_getter(var) "
+               "  return var:GetX() "
+               "end ");
+
+  TestClass var;
+  L.Call("accepts_TestClass", std::ref(var));
+  EXPECT_EQ(var.GetX(), 42);
+  EXPECT_EQ(L.Call<int>("const_getter", std::cref(var)), 42);
+
+  // Non-const methods are not available on const objects.
+  EXPECT_THROW(L.Call("accepts_TestClass", std::cref(var)),
+               Lua::LuaExecuteError);
+  EXPECT_THROW(L.LoadString("make_TestClass():SetX()"),
+               Lua::LuaExecuteError);
+}
+
+TEST(LuaClasses, NestedReferencesExpire){
+  Lua::LuaState L;
+  InitializeClass(L);
+
+  TestClass outer_var;
+  outer_var.SetX(1);
+  TestClass inner_var;
+  inner_var.SetX(2);
+
+  std::function<void()> call_inner = [&](){
+    L.Call("inner", std::ref(inner_var));
+  };
+  L.SetGlobal("call_inner", call_inner);
+
+  L.LoadString("saved_inner = nil "
+               "function inner(var) "
+               "  saved_inner = var "
+               "end "
+               "function outer(var) "
+               "  call_inner() "
+               "  return var:GetX(), saved_inner:GetX() == nil "
+               "end "
+               "function inner_is_expired() "
+               "  return saved_inner:GetX() == nil "
+               "end ");
+
+  auto res = L.Call<std::tuple<int, bool> >("outer", std::ref(outer_var));
+  EXPECT_EQ(std::get<0>(res), 1);
+  EXPECT_TRUE(std::get<1>(res));
+  EXPECT_TRUE(L.Call<bool>("inner_is_expired"));
+}
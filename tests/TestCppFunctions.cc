@@ -27,6 +27,36 @@ namespace{
   int double_const_integer(const int x) {
     return 2*x;
   }
+
+  void throws_exception() {
+    throw std::runtime_error("Exception from C++");
+  }
+
+  int count_zeros(Lua::StringRef str){
+    int output = 0;
+    for(char c : str){
+      if(c == '\0'){
+        output++;
+      }
+    }
+    return output;
+  }
+
+  double sum_values(Lua::TableView table){
+    double output = 0;
+    for(double value : table.Values<double>()){
+      output += value;
+    }
+    return output;
+  }
+
+  std::string lookup_name(Lua::TableView table){
+    return table.Has("name") ? table.Get<std::string>("name") : "unnamed";
+  }
+
+  int third_element(Lua::TableView table){
+    return table.At<int>(2);
+  }
 }
 
 TEST(CppFunctions, CallFunctions){
@@ -58,3 +88,68 @@ TEST(CppFunctions, CallFunctions){
   auto res5 = L.LoadString<int>("return double_const_integer(5)");
   EXPECT_EQ(res5, 10);
 }
+
+TEST(CppFunctions, BoundFunctions){
+  Lua::LuaState L;
+  L.SetGlobal("sum_integers", Lua::Bind<decltype(&sum_integers), &sum_integers>());
+  EXPECT_EQ(L.LoadString<int>("return sum_integers(5,10)"), 15);
+
+  L.SetGlobal("double_number", Lua::Bind<decltype(&double_number), &double_number>());
+  EXPECT_EQ(L.LoadString<double>("return double_number(2.5)"), 5.0);
+
+  external_var = 0;
+  L.SetGlobal("increment_integer", Lua::Bind<decltype(&increment_integer), &increment_integer>());
+  L.LoadString("increment_integer()");
+  EXPECT_EQ(external_var, 1);
+
+  L.SetGlobal("multiple_returns", Lua::Bind<decltype(&multiple_returns), &multiple_returns>());
+  EXPECT_EQ(L.LoadString<int>("x,y = multiple_returns(); return x+y"), 11);
+
+  EXPECT_THROW(L.LoadString("sum_integers(5)"), Lua::LuaExecuteError);
+
+  L.SetGlobal("throws_exception", Lua::Bind<decltype(&throws_exception), &throws_exception>());
+  EXPECT_THROW(L.LoadString("throws_exception()"), Lua::LuaExecuteError);
+}
+
+TEST(CppFunctions, StringArguments){
+  Lua::LuaState L;
+  L.LoadLibs();
+  L.SetGlobal("count_zeros", count_zeros);
+  EXPECT_EQ(L.LoadString<int>("return count_zeros('a\\0b\\0\\0c')"), 3);
+
+  L.SetGlobal("bound_count_zeros", Lua::Bind<decltype(&count_zeros), &count_zeros>());
+  EXPECT_EQ(L.LoadString<int>("return bound_count_zeros('\\0')"), 1);
+
+  std::function<size_t(Lua::StringRef)> length = [](Lua::StringRef str){ return str.size(); };
+  L.SetGlobal("length", length);
+  EXPECT_EQ(L.LoadString<int>("return length(string.rep('x', 100000))"), 100000);
+
+  // Numbers are converted to strings.
+  EXPECT_EQ(L.LoadString<int>("return length(12345)"), 5);
+  EXPECT_THROW(L.LoadString("length({})"), Lua::LuaExecuteError);
+
+  std::string with_null("a\0b", 3);
+  EXPECT_EQ(L.LoadString<std::string>("return 'a\\0b'"), with_null);
+}
+
+TEST(CppFunctions, TableViewArguments){
+  Lua::LuaState L;
+  L.SetGlobal("sum_values", Lua::Bind<decltype(&sum_values), &sum_values>());
+  L.SetGlobal("lookup_name", Lua::Bind<decltype(&lookup_name), &lookup_name>());
+  L.SetGlobal("third_element", Lua::Bind<decltype(&third_element), &third_element>());
+
+  EXPECT_EQ(L.LoadString<double>("return sum_values({1.5, 2.5, 3, x=100})"), 7.0);
+  EXPECT_EQ(L.LoadString<double>("return sum_values({})"), 0.0);
+  EXPECT_EQ(L.LoadString<std::string>("return lookup_name({name='widget', 1, 2})"), "widget");
+  EXPECT_EQ(L.LoadString<std::string>("return lookup_name({1, 2})"), "unnamed");
+
+  EXPECT_EQ(L.LoadString<int>("return third_element({4, 5, 6})"), 6);
+  EXPECT_THROW(L.LoadString("third_element({4, 5})"), Lua::LuaExecuteError);
+  EXPECT_THROW(L.LoadString("sum_values(5)"), Lua::LuaExecuteError);
+
+  // Entries are only converted when accessed.
+  EXPECT_EQ(L.LoadString<int>("return third_element({'not', 'numbers', 7})"), 7);
+
+  // Nothing is left on the stack.
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
@@ -1,5 +1,14 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
 #include <string>
 
+#include <unistd.h>
+
 #include <gtest/gtest.h>
 
 #include "lua-bindings/LuaState.hh"
@@ -14,6 +23,40 @@ TEST(LuaGlobals, ReadWriteIntegers){
   EXPECT_EQ(L.CastGlobal<int>("x"), 17);
 }
 
+TEST(LuaGlobals, ReadWriteLargeIntegers){
+  Lua::LuaState L;
+  L.LoadLibs();
+
+  // Not representable as a double.
+  long long big = (1LL << 60) + 1;
+  L.SetGlobal("big", big);
+  EXPECT_EQ(L.CastGlobal<long long>("big"), big);
+
+  L.LoadString("is_int = (math.type(big) == 'integer')");
+  EXPECT_TRUE(L.CastGlobal<bool>("is_int"));
+
+  L.LoadString("x = 2.75");
+  EXPECT_EQ(L.CastGlobal<int>("x"), 2);
+}
+
+TEST(LuaGlobals, ReadCheckedIntegers){
+  Lua::LuaState L;
+  L.LoadString("a = 300; b = 2.0; c = 2.5; d = -1; e = 'hi'");
+
+  EXPECT_EQ(L.CastGlobal<Lua::CheckedInteger<int> >("a"), 300);
+  EXPECT_EQ(L.CastGlobal<Lua::CheckedInteger<int> >("b"), 2);
+  EXPECT_THROW(L.CastGlobal<Lua::CheckedInteger<int> >("c"), Lua::LuaIntegerConversionError);
+  EXPECT_THROW(L.CastGlobal<Lua::CheckedInteger<unsigned char> >("a"), Lua::LuaIntegerConversionError);
+  EXPECT_THROW(L.CastGlobal<Lua::CheckedInteger<unsigned int> >("d"), Lua::LuaIntegerConversionError);
+  EXPECT_THROW(L.CastGlobal<Lua::CheckedInteger<int> >("e"), Lua::LuaIntegerConversionError);
+
+  // Unsigned 64-bit values pushed from C++ round-trip, even above the maximum lua_Integer.
+  L.SetGlobal("max", std::numeric_limits<uint64_t>::max());
+  EXPECT_EQ(L.CastGlobal<Lua::CheckedInteger<uint64_t> >("max").value,
+            std::numeric_limits<uint64_t>::max());
+  EXPECT_THROW(L.CastGlobal<Lua::CheckedInteger<uint32_t> >("max"), Lua::LuaIntegerConversionError);
+}
+
 TEST(LuaGlobals, ReadWriteStrings){
   Lua::LuaState L;
   L.LoadString("x = 'hi'; y = 'there'");
@@ -24,6 +67,176 @@ TEST(LuaGlobals, ReadWriteStrings){
   EXPECT_EQ(L.CastGlobal<std::string>("x"), "foo");
 }
 
+TEST(LuaGlobals, ReadWriteBinaryStrings){
+  Lua::LuaState L;
+  L.LoadLibs();
+
+  std::string binary("a\0b\0c", 5);
+  L.SetGlobal("binary", binary);
+  EXPECT_EQ(L.LoadString<int>("return #binary"), 5);
+  EXPECT_EQ(L.CastGlobal<std::string>("binary"), binary);
+
+  L.SetGlobal("span", Lua::StringRef(binary.data(), 3));
+  EXPECT_EQ(L.CastGlobal<std::string>("span"), std::string("a\0b", 3));
+}
+
+TEST(LuaGlobals, LoadBuffer){
+  Lua::LuaState L;
+
+  // Only the given length is loaded.
+  std::string code = "x = 5 -- trailing";
+  L.LoadBuffer(code.data(), 5, "=buffer");
+  EXPECT_EQ(L.CastGlobal<int>("x"), 5);
+
+  std::string with_null("y = '\0'", 7);
+  L.LoadBuffer(with_null.data(), with_null.size(), "=buffer");
+  EXPECT_EQ(L.CastGlobal<std::string>("y"), std::string(1, '\0'));
+
+  try{
+    L.LoadBuffer("x = ", 4, "=generated");
+    FAIL() << "Expected a parse error";
+  } catch(Lua::LuaFileParseError& e){
+    EXPECT_EQ(std::string(e.what()).find("generated:"), 0u);
+  }
+
+  // Failed loads leave nothing on the stack.
+  EXPECT_THROW(L.LoadFile("/nonexistent/file.lua"), Lua::LuaFileNotFound);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
+
+namespace{
+  int append_to_string(lua_State*, const void* data, size_t size, void* output){
+    static_cast<std::string*>(output)->append(static_cast<const char*>(data), size);
+    return 0;
+  }
+}
+
+TEST(LuaGlobals, LoadPrecompiled){
+  Lua::LuaState L;
+
+  ASSERT_EQ(luaL_loadstring(L.state(), "return 6*7"), LUA_OK);
+  std::string bytecode;
+  ASSERT_EQ(lua_dump(L.state(), append_to_string, &bytecode, 0), 0);
+  lua_pop(L.state(), 1);
+
+  EXPECT_EQ(L.LoadString<int>(bytecode), 42);
+  EXPECT_EQ(L.LoadBuffer<int>(bytecode.data(), bytecode.size(), "=bytecode"), 42);
+}
+
+TEST(LuaGlobals, CompiledChunk){
+  Lua::LuaState L;
+  L.LoadString("calls = 0");
+
+  auto chunk = L.Compile("calls = calls + 1 local x, y = ... return x*y", "=product");
+  EXPECT_EQ(L.CastGlobal<int>("calls"), 0);
+
+  EXPECT_EQ(chunk.Run<int>(3, 4), 12);
+  EXPECT_EQ(chunk.Run<int>(5, 6), 30);
+  EXPECT_EQ(L.CastGlobal<int>("calls"), 2);
+
+  // Copies refer to the same compiled function.
+  auto copy = chunk;
+  EXPECT_EQ(copy.Run<int>(2, 2), 4);
+
+  try{
+    chunk.Run<int>(1, "not a number");
+    FAIL() << "Expected an execution error";
+  } catch(Lua::LuaExecuteError& e){
+    EXPECT_EQ(std::string(e.what()).find("product:"), 0u);
+  }
+
+  EXPECT_THROW(L.Compile("return +", "=broken"), Lua::LuaFileParseError);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
+
+namespace{
+  // Returns the code in blocks of a single character.
+  class CharacterReader : public Lua::ChunkReader{
+  public:
+    CharacterReader(std::string code) : code(code), pos(0) { }
+
+    const char* Read(size_t& size) override {
+      if(pos == code.size()){
+        throw std::runtime_error("Read past the end");
+      }
+      size = 1;
+      return &code[pos++];
+    }
+
+  private:
+    std::string code;
+    size_t pos;
+  };
+
+  // Provides some code, then fails as a broken pipe or corrupt archive would.
+  class FailingStreamBuf : public std::streambuf{
+  public:
+    FailingStreamBuf(const std::string& code) : code(code), failed(false) { }
+
+  protected:
+    int_type underflow() override {
+      if(failed){
+        throw std::runtime_error("Stream failed");
+      }
+      failed = true;
+      setg(&code[0], &code[0], &code[0] + code.size());
+      return traits_type::to_int_type(code[0]);
+    }
+
+  private:
+    std::string code;
+    bool failed;
+  };
+}
+
+TEST(LuaGlobals, LoadStream){
+  Lua::LuaState L;
+
+  // Tokens are split across blocks.
+  std::istringstream stream("x = 'hello' .. ' world' return 42");
+  Lua::StreamReader reader(stream, 3);
+  EXPECT_EQ(L.LoadStream<int>(reader, "=stream"), 42);
+  EXPECT_EQ(L.CastGlobal<std::string>("x"), "hello world");
+
+  std::istringstream broken("x = ");
+  Lua::StreamReader broken_reader(broken);
+  EXPECT_THROW(L.LoadStream(broken_reader, "=stream"), Lua::LuaFileParseError);
+
+  // A stream that fails partway is not treated as the end of the code.
+  FailingStreamBuf failing_buf("return 1 + ");
+  std::istream failing(&failing_buf);
+  Lua::StreamReader failing_reader(failing, 4);
+  EXPECT_THROW(L.LoadStream(failing_reader, "=stream"), Lua::LuaStreamReadError);
+
+  // Exceptions from the reader are passed on.
+  CharacterReader char_reader("return 1");
+  EXPECT_THROW(L.LoadStream(char_reader, "=chars"), std::runtime_error);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
+
+TEST(LuaGlobals, LoadMappedFile){
+  char filename[] = "/tmp/lua-bindings-mapped-XXXXXX";
+  int fd = mkstemp(filename);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  std::ofstream(filename) << "y = {1, 2, 3} return #y";
+
+  Lua::LuaState L;
+  {
+    Lua::MappedFileReader reader(filename);
+    EXPECT_EQ(L.LoadStream<int>(reader, "@mapped"), 3);
+  }
+
+  std::ofstream(filename, std::ios::trunc).flush();
+  {
+    Lua::MappedFileReader reader(filename);
+    L.LoadStream(reader, "@empty");
+  }
+  unlink(filename);
+
+  EXPECT_THROW(Lua::MappedFileReader reader(filename), Lua::LuaFileNotFound);
+}
+
 TEST(LuaGlobals, ReadWriteBoolean){
   Lua::LuaState L;
   L.LoadString("x = true; y = false");
@@ -57,4 +57,70 @@ TEST(LuaFunctions, ReturnTable){
   EXPECT_EQ(map_res.size(), 2);
   EXPECT_EQ(map_res["a"], 1);
   EXPECT_EQ(map_res["b"], 42);
+
+  L.LoadString("function map_mixed_keys_return() "
+               "   return {a=1, [2]=3, [3.5]=4} "
+               "end");
+  auto mixed_res = L.Call<std::map<std::string, int> >("map_mixed_keys_return");
+  EXPECT_EQ(mixed_res.size(), 3);
+  EXPECT_EQ(mixed_res["a"], 1);
+  EXPECT_EQ(mixed_res["2"], 3);
+  EXPECT_EQ(mixed_res["3.5"], 4);
+}
+
+TEST(LuaFunctions, PassTable){
+  Lua::LuaState L;
+  L.LoadString("function sum_vector(t) "
+               "  local total = 0 "
+               "  for i=1,#t do total = total + t[i] end "
+               "  return total "
+               "end "
+               "function map_entry(t, key) "
+               "  return t[key] "
+               "end");
+
+  std::vector<int> vec(1000);
+  for(unsigned int i=0; i<vec.size(); i++){
+    vec[i] = i;
+  }
+  EXPECT_EQ(L.Call<int>("sum_vector", vec), 999*1000/2);
+
+  std::map<std::string, int> map{{"a", 1}, {"b", 42}};
+  EXPECT_EQ(L.Call<int>("map_entry", map, "b"), 42);
+}
+
+TEST(LuaFunctions, FunctionHandle){
+  Lua::LuaState L;
+  L.LoadString("function sum(x, y) return x+y end "
+               "function multireturn() return 3,4 end ");
+
+  auto sum = L.GetFunction<int(int,int)>("sum");
+  EXPECT_EQ(sum(1, 2), 3);
+  EXPECT_EQ(sum(40, 2), 42);
+
+  auto multireturn = L.GetFunction<std::tuple<int,int>()>("multireturn");
+  EXPECT_EQ(multireturn(), std::make_tuple(3,4));
+
+  // The handle keeps the function it was given.
+  L.LoadString("sum = nil");
+  EXPECT_EQ(sum(5, 6), 11);
+
+  EXPECT_THROW(L.GetFunction<int(int,int)>("sum"), Lua::LuaInvalidStackContents);
+
+  L.LoadString("number = 5 "
+               "text = 'sum' "
+               "table = {}");
+  EXPECT_THROW(L.GetFunction<int()>("number"), Lua::LuaInvalidStackContents);
+  EXPECT_THROW(L.GetFunction<int()>("text"), Lua::LuaInvalidStackContents);
+  EXPECT_THROW(L.GetFunction<int()>("table"), Lua::LuaInvalidStackContents);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
+
+TEST(LuaFunctions, CallableHandle){
+  Lua::LuaState L;
+  L.LoadLibs();
+  L.LoadString("callable = setmetatable({}, {__call = function(self, x) return 2*x end})");
+
+  auto callable = L.GetFunction<int(int)>("callable");
+  EXPECT_EQ(callable(21), 42);
 }
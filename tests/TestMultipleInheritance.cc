@@ -14,6 +14,18 @@ namespace {
   struct Derived : BaseA, BaseB {
     int z;
   };
+
+  struct BaseC {
+    int w;
+  };
+
+  struct MostDerived : BaseC, Derived {
+    int v;
+  };
+
+  struct VirtualDerived : BaseC, virtual BaseB {
+    int u;
+  };
 }
 
 TEST(LuaSubclasses, ConvertToBaseA) {
@@ -47,3 +59,59 @@ TEST(LuaSubclasses, ConvertToBaseB) {
   EXPECT_EQ(base_cpp, base_lua);
   EXPECT_EQ(base_cpp, base_lua_const);
 }
+
+TEST(LuaSubclasses, ConvertThroughChain) {
+  Lua::LuaState L;
+  L.MakeClass<BaseB>("BaseB");
+  L.MakeClass<Derived, BaseB>("Derived");
+  L.MakeClass<MostDerived, Derived>("MostDerived");
+
+  MostDerived most_derived;
+  L.SetGlobal("most_derived",&most_derived);
+
+  BaseB* base_cpp = static_cast<BaseB*>(&most_derived);
+  Derived* derived_cpp = static_cast<Derived*>(&most_derived);
+
+  // Read repeatedly, to use the cached upcasters after the first read.
+  for(int i=0; i<3; i++){
+    EXPECT_EQ(base_cpp, L.CastGlobal<BaseB*>("most_derived"));
+    EXPECT_EQ(base_cpp, L.CastGlobal<const BaseB*>("most_derived"));
+    EXPECT_EQ(derived_cpp, L.CastGlobal<Derived*>("most_derived"));
+  }
+
+  Derived derived;
+  L.SetGlobal("derived",&derived);
+  EXPECT_THROW(L.CastGlobal<MostDerived*>("derived"), Lua::LuaInvalidStackContents);
+  EXPECT_THROW(L.CastGlobal<MostDerived*>("derived"), Lua::LuaInvalidStackContents);
+}
+
+TEST(LuaSubclasses, ConvertThroughVirtualBase) {
+  Lua::LuaState L;
+  L.MakeClass<BaseB>("BaseB");
+  L.MakeClass<VirtualDerived, BaseB>("VirtualDerived");
+
+  VirtualDerived derived;
+  L.SetGlobal("derived",&derived);
+  EXPECT_EQ(static_cast<BaseB*>(&derived), L.CastGlobal<BaseB*>("derived"));
+
+  auto shared = std::make_shared<VirtualDerived>();
+  L.SetGlobal("shared", shared);
+  auto base_shared = L.CastGlobal<std::shared_ptr<BaseB> >("shared");
+  EXPECT_EQ(static_cast<BaseB*>(shared.get()), base_shared.get());
+  EXPECT_EQ(shared.use_count(), 3);
+}
+
+TEST(LuaSubclasses, SharedPointerUpcastOwnership) {
+  Lua::LuaState L;
+  L.MakeClass<BaseB>("BaseB");
+  L.MakeClass<Derived, BaseB>("Derived");
+
+  auto shared = std::make_shared<Derived>();
+  L.SetGlobal("shared", shared);
+  auto base_shared = L.CastGlobal<std::shared_ptr<BaseB> >("shared");
+  std::weak_ptr<BaseB> base_weak = L.CastGlobal<std::weak_ptr<BaseB> >("shared");
+
+  EXPECT_EQ(static_cast<BaseB*>(shared.get()), base_shared.get());
+  EXPECT_EQ(static_cast<BaseB*>(shared.get()), base_weak.lock().get());
+  EXPECT_EQ(shared.use_count(), 3);
+}
@@ -0,0 +1,93 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "lua-bindings/LuaState.hh"
+
+namespace{
+  struct Point{
+    double x;
+    double y;
+  };
+  LUA_REFLECT(Point, x, y);
+
+  struct Event{
+    int id;
+    std::string name;
+    Point position;
+    std::vector<int> tags;
+    bool enabled = true;
+  };
+  LUA_REFLECT(Event, id, name, position, tags, enabled);
+}
+
+namespace config{
+  struct Limits{
+    int max_connections;
+    double timeout;
+  };
+  LUA_REFLECT(Limits, max_connections, timeout);
+}
+
+TEST(LuaReflect, PushAsTable){
+  Lua::LuaState L;
+  L.SetGlobal("point", Point{1.5, -2.0});
+
+  EXPECT_EQ(L.LoadString<double>("return point.x"), 1.5);
+  EXPECT_EQ(L.LoadString<double>("return point.y"), -2.0);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+}
+
+TEST(LuaReflect, ReadFromTable){
+  Lua::LuaState L;
+  L.LoadString("limits = {max_connections=64, timeout=2.5, unrelated='ignored'}");
+
+  auto limits = L.CastGlobal<config::Limits>("limits");
+  EXPECT_EQ(limits.max_connections, 64);
+  EXPECT_EQ(limits.timeout, 2.5);
+  EXPECT_EQ(lua_gettop(L.state()), 0);
+
+  L.LoadString("not_table = 5");
+  EXPECT_THROW(L.CastGlobal<config::Limits>("not_table"), Lua::LuaInvalidStackContents);
+}
+
+TEST(LuaReflect, RoundTrip){
+  Lua::LuaState L;
+  L.LoadString("function rename(event) "
+               "  event.name = event.name .. '!' "
+               "  event.position.x = event.position.x + 1 "
+               "  return event "
+               "end");
+
+  Event event{7, "click", {3, 4}, {1, 2, 3}, false};
+  Event output = L.Call<Event>("rename", event);
+  EXPECT_EQ(output.id, 7);
+  EXPECT_EQ(output.name, "click!");
+  EXPECT_EQ(output.position.x, 4);
+  EXPECT_EQ(output.position.y, 4);
+  EXPECT_EQ(output.tags, std::vector<int>({1, 2, 3}));
+  EXPECT_FALSE(output.enabled);
+}
+
+TEST(LuaReflect, MissingFieldsKeepDefaults){
+  Lua::LuaState L;
+  L.LoadString("event = {id=3}");
+
+  auto event = L.CastGlobal<Event>("event");
+  EXPECT_EQ(event.id, 3);
+  EXPECT_EQ(event.name, "");
+  EXPECT_TRUE(event.tags.empty());
+  EXPECT_TRUE(event.enabled);
+}
+
+TEST(LuaReflect, VectorOfStructs){
+  Lua::LuaState L;
+  L.LoadString("function total_x(points) "
+               "  local total = 0 "
+               "  for i=1,#points do total = total + points[i].x end "
+               "  return total "
+               "end");
+  std::vector<Point> points = {{1, 0}, {2, 0}, {3, 0}};
+  EXPECT_EQ(L.Call<double>("total_x", points), 6);
+}
@@ -0,0 +1,138 @@
+#include <memory>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "lua-bindings/LuaState.hh"
+
+namespace{
+  class RefCounted{
+  public:
+    RefCounted() : refcount(0) { }
+    virtual ~RefCounted() { }
+
+    void AddRef() { refcount++; }
+    void Release() {
+      refcount--;
+      if(refcount == 0){
+        delete this;
+      }
+    }
+    int RefCount() const { return refcount; }
+
+  private:
+    int refcount;
+  };
+
+  template<typename T>
+  class IntrusivePtr{
+  public:
+    IntrusivePtr(T* ptr = nullptr) : ptr(ptr) {
+      if(ptr){
+        ptr->AddRef();
+      }
+    }
+    IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr) { }
+    IntrusivePtr(IntrusivePtr&& other) : ptr(other.ptr) {
+      other.ptr = nullptr;
+    }
+    ~IntrusivePtr() {
+      if(ptr){
+        ptr->Release();
+      }
+    }
+    IntrusivePtr& operator=(IntrusivePtr other) {
+      std::swap(ptr, other.ptr);
+      return *this;
+    }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+
+  private:
+    T* ptr;
+  };
+
+  class Shape : public RefCounted{
+  public:
+    Shape(int x) : x(x) { }
+    int GetX() const { return x; }
+  private:
+    int x;
+  };
+
+  class Circle : public Shape{
+  public:
+    Circle(int x) : Shape(x) { }
+  };
+}
+
+namespace Lua{
+  template<typename T>
+  struct SmartPointerTraits<IntrusivePtr<T> >{
+    typedef T element_type;
+    static T* get(const IntrusivePtr<T>& ptr) { return ptr.get(); }
+    static IntrusivePtr<T> from_raw(T* ptr) { return IntrusivePtr<T>(ptr); }
+  };
+}
+
+TEST(LuaSmartPointers, PushAndRead){
+  IntrusivePtr<Shape> shape(new Shape(5));
+  {
+    Lua::LuaState L;
+    L.MakeClass<Shape>("Shape")
+      .AddMethod("GetX", &Shape::GetX);
+
+    L.SetGlobal("shape", shape);
+    EXPECT_EQ(shape->RefCount(), 2);
+
+    L.LoadString("x = shape:GetX()");
+    EXPECT_EQ(L.CastGlobal<int>("x"), 5);
+
+    auto read = L.CastGlobal<IntrusivePtr<Shape> >("shape");
+    EXPECT_EQ(read.get(), shape.get());
+    EXPECT_EQ(shape->RefCount(), 3);
+
+    // Objects owned by Lua cannot be shared.
+    L.SetGlobal("value", Shape(7));
+    EXPECT_THROW(L.CastGlobal<IntrusivePtr<Shape> >("value"), Lua::LuaIncorrectPointerType);
+
+    L.SetGlobal("null", IntrusivePtr<Shape>());
+    EXPECT_EQ(L.CastGlobal<IntrusivePtr<Shape> >("null").get(), nullptr);
+  }
+  EXPECT_EQ(shape->RefCount(), 1);
+}
+
+TEST(LuaSmartPointers, ReadAsBaseClass){
+  Lua::LuaState L;
+  L.MakeClass<Shape>("Shape");
+  L.MakeClass<Circle, Shape>("Circle");
+
+  IntrusivePtr<Circle> circle(new Circle(3));
+  L.SetGlobal("circle", circle);
+
+  auto shape = L.CastGlobal<IntrusivePtr<Shape> >("circle");
+  EXPECT_EQ(shape.get(), static_cast<Shape*>(circle.get()));
+  EXPECT_EQ(shape->GetX(), 3);
+  EXPECT_EQ(L.CastGlobal<Circle*>("circle"), circle.get());
+}
+
+TEST(LuaSmartPointers, OtherPointerTypesCannotBeRead){
+  Lua::LuaState L;
+  L.MakeClass<Shape>("Shape");
+
+  IntrusivePtr<Shape> shape(new Shape(5));
+  L.SetGlobal("raw", shape.get());
+  EXPECT_THROW(L.CastGlobal<IntrusivePtr<Shape> >("raw"), Lua::LuaIncorrectPointerType);
+
+  // The object is not reference counted by the shared_ptr, so it must not be deleted by it.
+  std::shared_ptr<Shape> shared(shape.get(), [](Shape*){});
+  L.SetGlobal("shared", shared);
+  EXPECT_THROW(L.CastGlobal<IntrusivePtr<Shape> >("shared"), Lua::LuaIncorrectPointerType);
+
+  EXPECT_EQ(shape->RefCount(), 1);
+
+  // Nor can a custom smart pointer be read as a std::shared_ptr.
+  L.SetGlobal("intrusive", shape);
+  EXPECT_THROW(L.CastGlobal<std::shared_ptr<Shape> >("intrusive"), Lua::LuaIncorrectPointerType);
+}
@@ -31,3 +31,21 @@ TEST(LuaStdFunction, CallClosure){
   EXPECT_EQ(func(), 2);
   EXPECT_EQ(func(), 3);
 }
+
+TEST(LuaStdFunction, RoundTripCppFunction){
+  Lua::LuaState L;
+  L.LoadLibs();
+  int times_called = 0;
+  std::function<int(int)> func = [&times_called](int x){
+    times_called++;
+    return 2*x;
+  };
+  L.SetGlobal("func", func);
+
+  EXPECT_EQ(L.LoadString<int>("return func(21)"), 42);
+  EXPECT_EQ(L.LoadString<std::string>("return type(func)"), "function");
+
+  auto from_lua = L.CastGlobal<std::function<int(int)> >("func");
+  EXPECT_EQ(from_lua(5), 10);
+  EXPECT_EQ(times_called, 2);
+}
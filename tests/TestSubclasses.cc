@@ -87,3 +87,33 @@ TEST(LuaSubclasses, InheritanceChain) {
 
   EXPECT_EQ(from_lua, from_cpp);
 }
+
+TEST(LuaSubclasses, BaseClassRegisteredLater) {
+  Lua::LuaState L;
+  L.MakeClass<DerivedClass>("DerivedClass");
+
+  DerivedClass derived;
+  L.SetGlobal("derived", &derived);
+  EXPECT_THROW(L.CastGlobal<BaseClass*>("derived"), Lua::LuaInvalidStackContents);
+
+  // Registering again reuses the metatable, which now knows its base class.
+  L.MakeClass<BaseClass>("BaseClass");
+  L.MakeClass<DerivedClass, BaseClass>("DerivedClass");
+  EXPECT_EQ(L.CastGlobal<BaseClass*>("derived"), static_cast<BaseClass*>(&derived));
+}
+
+TEST(LuaSubclasses, ReregisterAfterRead) {
+  Lua::LuaState L;
+  L.MakeClass<StructA>("StructA");
+  L.MakeClass<StructB>("StructB");
+  L.MakeClass<StructC, StructB>("StructC");
+
+  StructC struct_c;
+  L.SetGlobal("struct_c", &struct_c);
+  EXPECT_EQ(L.CastGlobal<StructB*>("struct_c"), static_cast<StructB*>(&struct_c));
+
+  // The upcaster replaced by registering again must stay valid for the cached lookup.
+  L.MakeClass<StructC, StructB>("StructC");
+  lua_gc(L.state(), LUA_GCCOLLECT, 0);
+  EXPECT_EQ(L.CastGlobal<StructB*>("struct_c"), static_cast<StructB*>(&struct_c));
+}